@@ -0,0 +1,9 @@
+#version 330 core
+
+out vec4 FragColor;
+
+// Bound while the real programs are still compiling.
+void main()
+{
+    FragColor = vec4( 0.8, 0.8, 0.8, 1.0 );
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#version 330 core
+in vec4 vertexColor;
+
+out vec4 FragColor;
+
+layout ( std140 ) uniform FrameConstants
+{
+    vec4 time;
+    vec4 viewport;
+} frame;
+
+layout ( std140 ) uniform MaterialConstants
+{
+    vec4 color;
+    // x = pulse speed.
+    vec4 parameters;
+} material;
+
+void main()
+{
+    float pulse = 0.75 + 0.25 * sin( frame.time.x * material.parameters.x );
+    FragColor = vertexColor * material.color * pulse;
+}
\ No newline at end of file
@@ -3,9 +3,13 @@ in vec4 vertexColor;
 
 out vec4 FragColor;
 
-uniform vec4 renderColor;
+layout ( std140 ) uniform FrameConstants
+{
+    vec4 time;
+    vec4 viewport;
+} frame;
 
 void main()
 {
-    FragColor = renderColor;
+    FragColor = vec4( sin( frame.time.x*2.0+3.14159265 )*0.5+0.5, sin( frame.time.x*2.0 )*0.5+0.5, 0.0, 1.0 );
 }
\ No newline at end of file
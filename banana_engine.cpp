@@ -2,78 +2,385 @@
 #define BANANA_ENGINE
 
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
+#include <chrono>
 #include <cmath>
+#include <random>
 #include <string>
+#include <vector>
+#include "bvh.h"
+#include "engine_settings.h"
+#include "fixed_timestep.h"
+#include "frame_pacer.h"
+#include "frustum_culler.h"
+#include "gl_state_cache.h"
+#include "headless_context.h"
+#include "input_map.h"
+#include "input_queue.h"
+#include "job_system.h"
+#include "lod_selector.h"
+#include "mesh_optimizer.h"
+#include "mesh_registry.h"
+#include "occlusion_culler.h"
+#include "profiler.h"
+#include "quad_batch.h"
+#include "render_queue.h"
+#include "render_target.h"
+#include "render_thread.h"
+#include "resolution_scaler.h"
 #include "shader.h"
+#include "shader_batch.h"
+#include "uniform_buffer.h"
+
+
+// Position and color, as Shaders/shader.vertex reads them: 24 bytes per vertex.
+constexpr VertexAttribute COLOR_VERTEX[] = {
+    { 0, 3, VertexEncoding::FLOAT },
+    { 1, 3, VertexEncoding::FLOAT },
+};
+
+// The same vertex in 12 bytes: half-float position, UNORM8 color.
+constexpr VertexAttribute COMPACT_COLOR_VERTEX[] = {
+    { 0, 3, VertexEncoding::HALF },
+    { 1, 3, VertexEncoding::UNORM8 },
+};
+
+
+// Everything the GL side needs to draw one frame, recorded on the main thread.
+struct FramePacket
+{
+    FrameConstants constants = {};
+    DrawList drawList;
+    bool cullFace = false;
+    // The quad field streams straight into mapped GL memory, so it is built where it is
+    // drawn, from these interpolated rotations.
+    bool quadField = false;
+    std::vector<float> quadRotations;
+};
+
+
+// What the fixed-rate update advances; each frame draws a blend of the last two.
+struct SimulationState
+{
+    double time = 0.0;
+    std::vector<float> quadRotations;
+};
+
+
+// Totals for one Start() run, filled in when the main loop ends.
+struct RunStats
+{
+    int frames = 0;
+    double seconds = 0.0;
+    // Recording and sorting on the main thread plus GL submission, wherever it ran.
+    double renderCpuSeconds = 0.0;
+    // With the render thread: the main thread waiting for a free packet, and the render
+    // thread waiting for a submitted one.
+    double packetWaitSeconds = 0.0;
+    double renderIdleSeconds = 0.0;
+    // Main loop time spent holding to maxFps, and GL-side time waiting for the GPU to finish
+    // older frames.
+    double limiterSeconds = 0.0;
+    double gpuWaitSeconds = 0.0;
+    // Fixed-rate updates run, and the time dropped when a frame hit the step limit.
+    long long simulationSteps = 0;
+    double simulationDroppedSeconds = 0.0;
+    // Average scene render scale, measured GPU frame time and CPU time of the frame's GL
+    // calls; 1, 0 and 0 without dynamic resolution. cpuTimedFrames counts the frames the
+    // scale followed the CPU time, the GPU timestamps not tracking the frame.
+    double renderScale = 1.0;
+    long long renderScaleChanges = 0;
+    long long renderScaleShrinksUndone = 0;
+    double gpuFrameMs = 0.0;
+    double cpuFrameMs = 0.0;
+    long long cpuTimedFrames = 0;
+    long long drawCalls = 0;
+    long long commandsDrawn = 0;
+    long long programBinds = 0;
+    long long vaoBinds = 0;
+    long long uniformUpdates = 0;
+    long long materialBinds = 0;
+    GLStateStats glStateCalls;
+    // Frustum culling of the benchmark scene; culling seconds are wall time of the Cull() calls.
+    long long objectsTested = 0;
+    long long objectsVisible = 0;
+    double cullSeconds = 0.0;
+    // Occlusion culling of the frustum survivors against the benchmark walls.
+    long long objectsOccluded = 0;
+    double occlusionSeconds = 0.0;
+    // Triangles in the mesh draws of the sphere and benchmark scenes, after level of detail.
+    long long trianglesSubmitted = 0;
+    // Post-transform cache simulation of the largest static mesh, as loaded and as uploaded.
+    size_t largestMeshTriangles = 0;
+    VertexCacheStats meshCacheBefore;
+    VertexCacheStats meshCacheAfter;
+    std::string renderer;
+    // Per-scope timings; empty unless profiling was on.
+    std::vector<ProfileStats> scopes;
+};
 
 
 class BananaEngine
 {
+    private: EngineSettings settings;
     private: GLFWwindow* window = nullptr;
+    private: HeadlessContext headlessContext;
+    // Window framebuffer size, set from the resize callback on the main thread and read
+    // wherever the frame is drawn.
+    private: std::atomic<int> framebufferWidth { 0 };
+    private: std::atomic<int> framebufferHeight { 0 };
     private: std::string currentExecutablePath = "\0";
 
+    // Simulation time drawn this frame, between the last two steps.
     private: float time = 0.0;
+    private: std::chrono::steady_clock::time_point startTime;
+    private: FixedTimestep timestep;
+    private: FramePacer pacer;
+    private: SimulationState simulationStates[2];
+    private: int currentState = 0;
 
+    // Filled by the GLFW callbacks during PollEvents(), drained a simulation step at a time.
+    private: InputQueue inputQueue;
+    private: InputMap inputMap;
+    private: static constexpr int ACTION_QUIT = 0;
+    private: static constexpr int ACTION_SHOW_RECTANGLE = 1;
+    private: static constexpr int ACTION_SWAP_SHADER = 2;
     private: bool x = false;
     private: bool z = false;
 
     private: Shader* shader;
     private: Shader* shader2;
+    private: Shader* fallbackShader;
+    private: Shader* instancedShader;
+    private: std::vector<Shader*> benchShaders;
+    private: std::vector<int> benchTransformHandles;
+    private: ShaderBatch shaderBatch;
+
+    private: static constexpr int MAX_MATERIALS = 256;
+    // Clip-space z of the benchmark walls; the grid sits at 0.
+    private: static constexpr float OCCLUDER_DEPTH = -0.5f;
+    private: static constexpr float SPHERE_RADIUS = 0.9f;
+    // Meshes smaller than this are drawn in full; a coarser level would save next to nothing.
+    private: static constexpr size_t LOD_MIN_TRIANGLES = 256;
+    private: UniformBuffer frameUniforms;
+    private: UniformBuffer materialUniforms;
+    private: float lastFrameTime = 0.0;
+    // Radians per second the quads of the quad field turn.
+    private: static constexpr float QUAD_SPIN = 1.0f;
+
+    private: MeshRegistry meshes;
+    private: int colorVertexFormat = -1;
+    private: int triangleMesh = -1;
+    private: int rectangleMesh = -1;
+    private: int sphereMesh = -1;
+    private: QuadBatch quadBatch;
+    private: JobSystem jobs;
+    private: BoundsStore benchBounds;
+    private: FrustumCuller culler;
+    private: Bvh benchBvh;
+    private: std::vector<int> bvhVisible;
+    private: long long culls = 0;
+    private: long long objectsTested = 0;
+    private: long long objectsVisible = 0;
+    private: double cullSeconds = 0.0;
+    private: OcclusionCuller occlusionCuller;
+    private: std::vector<uint32_t> occlusionVisible;
+    private: std::vector<float> rectangleVertices;
+    private: std::vector<unsigned int> rectangleIndices;
+    private: double occlusionSeconds = 0.0;
+    private: LodSelector lodSelector;
+    private: long long trianglesSubmitted = 0;
+    private: RenderQueue renderQueue;
+    private: Profiler profiler;
 
-    private: unsigned int triangleVBO;
-    private: unsigned int triangleVAO;
-    private: unsigned int rectangleVBO;
-    private: unsigned int rectangleVAO;
-    private: unsigned int rectangleEBO;
+    // The scene draws here at a fraction of the window size, then is stretched onto it.
+    private: RenderTarget sceneTarget;
+    private: GpuFrameTimer gpuFrameTimer;
+    private: ResolutionScaler resolutionScaler;
+    private: int displayWidth = 0;
+    private: int displayHeight = 0;
+    // Milliseconds the last DrawFrame() spent on GL calls and GPU waits, up to the swap.
+    private: float drawFrameMs = -1.0f;
+    // Scale of the last frame drawn, for the main thread's level of detail picks.
+    private: std::atomic<float> renderScale { 1.0f };
+
+    private: RenderThread renderThread;
+    private: FramePacket packets[RenderThread::PACKET_COUNT];
+    // Set by whichever thread owns GL once the benchmark programs have their uniform handles.
+    private: std::atomic<bool> shadersLoaded { false };
+    private: double recordCpuSeconds = 0.0;
+    private: double submitCpuSeconds = 0.0;
+    private: RunStats runStats;
 
 
     public: void Start()
     {
+        Start( EngineSettings() );
+    }
+
+
+    public: const RunStats& GetRunStats() const
+    {
+        return runStats;
+    }
+
+
+    public: void Start( const EngineSettings& settings )
+    {
+        this->settings = settings;
+        // Nothing to hand over without frames to draw.
+        if ( !settings.rendering )
+            this->settings.renderThread = false;
         if ( Init() != 0 )
         {
             std::cout << "Failed to start engine. Terminating proccess!" << std::endl;
             return;
         }
 
+        jobs.Init( settings.jobThreads );
+        if ( !settings.headless )
+            LoadInput();
+        LoadUniformBuffers();
         LoadShaders();
-        LoadTriangle();
-        LoadRectangle();
+        LoadMeshes();
+        quadBatch.Init( meshes, rectangleMesh, 65536, settings.persistentMapping );
+        if ( settings.triangleCount > 0 || settings.rectangleCount > 0 )
+            LoadBenchBounds();
+        lodSelector.pixelError = settings.lodPixelError;
+        lodSelector.Resize( std::max( settings.triangleCount + settings.rectangleCount, 1 ) );
+        renderQueue.submitMode = settings.drawSubmission;
+        if ( settings.drawSubmission == RenderQueue::SUBMIT_INDIRECT )
+            renderQueue.InitIndirect( 65536, settings.persistentMapping );
+        // Keep shader compilation out of the measured frames of fixed-length runs.
+        if ( settings.headless || settings.maxFrames > 0 )
+            FinishShaderLoading();
+        if ( settings.dynamicResolution && settings.rendering )
+            LoadSceneTarget();
+
+        profiler.enabled = settings.profile || !settings.traceFile.empty();
+        profiler.recordTrace = !settings.traceFile.empty();
 
-        while( !glfwWindowShouldClose( window ) )
+        InitSimulation();
+        pacer.Init( settings.maxFps, settings.maxFramesInFlight );
+        startTime = std::chrono::steady_clock::now();
+        if ( this->settings.renderThread )
+            StartRenderThread();
+        int frameCount = 0;
+        double lastTime = GetTime();
+        while( !ShouldClose( frameCount ) )
         {
-            time = glfwGetTime();
-            HandleInput();
-            Render();
-            glfwSwapBuffers( window );
-            glfwPollEvents();
+            if ( this->settings.renderThread )
+                profiler.BeginCpu( "Frame" );
+            else
+                profiler.BeginFrame();
+            {
+                ProfileScope scope( profiler, "LimitFrameRate" );
+                pacer.LimitFrameRate();
+            }
+            double now = GetTime();
+            double frameSeconds = now - lastTime;
+            lastTime = now;
+            {
+                ProfileScope scope( profiler, "Simulate" );
+                // Without rendering there is no frame rate to keep up with, so step as fast as possible.
+                int steps = timestep.Advance( settings.rendering ? frameSeconds : timestep.stepSeconds );
+                // Each step sees the input that came in before the real time it ends at; the
+                // last one ends where the blend toward the next step begins.
+                double stepEnd = now - ( timestep.GetAlpha() + steps - 1 ) * timestep.stepSeconds;
+                for ( int i = 0; i < steps; i++ )
+                {
+                    HandleInput( stepEnd );
+                    StepSimulation();
+                    stepEnd += timestep.stepSeconds;
+                }
+            }
+            if ( this->settings.renderThread )
+            {
+                int packet = 0;
+                {
+                    ProfileScope scope( profiler, "WaitForPacket" );
+                    packet = renderThread.AcquirePacket();
+                }
+                RecordFrame( packets[packet], frameCount );
+                renderThread.SubmitPacket();
+            }
+            else if ( settings.rendering )
+            {
+                RecordFrame( packets[0], frameCount );
+                DrawFrame( packets[0] );
+            }
+            PollEvents();
+            profiler.EndFrame();
+            frameCount++;
         }
-        
+        if ( this->settings.renderThread )
+            StopRenderThread();
+
+        CollectRunStats( frameCount );
+        if ( settings.headless )
+            ReportHeadlessRun( frameCount );
+        if ( profiler.enabled )
+            ReportProfile();
+
+        profiler.Unload();
+        sceneTarget.Unload();
+        gpuFrameTimer.Unload();
+        quadBatch.Unload();
+        culler.Unload();
+        jobs.Unload();
+        renderQueue.Unload();
+        meshes.Unload();
         UnloadShaders();
-        glfwTerminate();
+        UnloadUniformBuffers();
+        pacer.Unload();
+        Terminate();
     }
 
 
     private: int Init()
     {
+        if ( settings.headless )
+        {
+            if ( settings.maxFrames <= 0 )
+            {
+                std::cout << "Headless mode needs a frame limit" << std::endl;
+                return -1;
+            }
+            if ( headlessContext.Init( settings.width, settings.height ) != 0 )
+            {
+                std::cout << "Failed to create headless context" << std::endl;
+                return -1;
+            }
+            GLStateCache::Invalidate();
+            GLStateCache::ResetStats();
+            GLStateCache::Viewport( 0, 0, settings.width, settings.height );
+            OnWindowResized( settings.width, settings.height );
+            return 0;
+        }
+
         glfwInit();
-        glfwWindowHint( GLFW_RESIZABLE, GLFW_FALSE );
+        glfwWindowHint( GLFW_RESIZABLE, GLFW_TRUE );
         glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
         glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
         glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
         // UNCOMMENT NEXT LINE IF ON MAC
         // glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE );
         
-        window = glfwCreateWindow( 800, 600, "LearnOpenGL", NULL, NULL );
+        window = glfwCreateWindow( settings.width, settings.height, "LearnOpenGL", NULL, NULL );
         if (window == NULL)
         {
             std::cout << "Failed to create GLFW window" << std::endl;
             glfwTerminate();
             return -1;
         }
+        // The window only hands back a pointer to find the engine from its callbacks.
+        glfwSetWindowUserPointer( window, this );
         glfwMakeContextCurrent( window );
+        glfwSwapInterval( GetSwapInterval() );
         
         
         if (!gladLoadGLLoader( ( GLADloadproc ) glfwGetProcAddress ) )
@@ -82,134 +389,1072 @@ class BananaEngine
             return -1;
         }  
         
-        glViewport( 0, 0, 800, 600 );
-        // glfwSetFramebufferSizeCallback( window, (( GLFWwindow* window, int width, int height ) => OnWindowResized( width, height )) );
+        GLStateCache::Invalidate();
+        GLStateCache::ResetStats();
+        GLStateCache::Viewport( 0, 0, settings.width, settings.height );
+        // The framebuffer can be larger than the window on high-DPI displays.
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize( window, &width, &height );
+        OnWindowResized( width, height );
+        glfwSetFramebufferSizeCallback( window, []( GLFWwindow* window, int width, int height )
+        {
+            GetEngine( window )->OnWindowResized( width, height );
+        } );
         
         return 0;
     }
 
 
-    private: void HandleInput()
+    private: void Terminate()
+    {
+        if ( settings.headless )
+            headlessContext.Terminate();
+        else
+            glfwTerminate();
+    }
+
+
+    // Adaptive vsync is a negative interval, where the driver supports it.
+    private: int GetSwapInterval()
+    {
+        if ( settings.vsync == FramePacer::VSYNC_ADAPTIVE )
+        {
+            if ( glfwExtensionSupported( "GLX_EXT_swap_control_tear" ) || glfwExtensionSupported( "WGL_EXT_swap_control_tear" ) )
+                return -1;
+            std::cout << "Adaptive vsync is not supported, using vsync" << std::endl;
+            return 1;
+        }
+        return settings.vsync == FramePacer::VSYNC_OFF ? 0 : 1;
+    }
+
+
+    private: bool ShouldClose( int frameCount )
+    {
+        if ( settings.maxFrames > 0 && frameCount >= settings.maxFrames )
+            return true;
+        return !settings.headless && glfwWindowShouldClose( window );
+    }
+
+
+    private: double GetTime()
+    {
+        if ( !settings.headless )
+            return glfwGetTime();
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+    }
+
+
+    private: void Present()
+    {
+        if ( settings.headless )
+        {
+            ProfileScope scope( profiler, "Present" );
+            headlessContext.Present();
+            return;
+        }
+        ProfileScope scope( profiler, "SwapBuffers" );
+        glfwSwapBuffers( window );
+    }
+
+
+    // GLFW only takes events on the main thread, whichever thread swaps.
+    private: void PollEvents()
+    {
+        if ( settings.headless )
+            return;
+        ProfileScope scope( profiler, "PollEvents" );
+        glfwPollEvents();
+    }
+
+
+    // A GL context is current on at most one thread at a time.
+    private: void MakeContextCurrent( bool current )
+    {
+        if ( settings.headless )
+            headlessContext.MakeCurrent( current );
+        else
+            glfwMakeContextCurrent( current ? window : NULL );
+    }
+
+
+    // Hands the GL context to the render thread for the rest of the run.
+    private: void StartRenderThread()
+    {
+        profiler.NameThread( "Main" );
+        MakeContextCurrent( false );
+        renderThread.Start( [this]()
+        {
+            MakeContextCurrent( true );
+            profiler.NameThread( "Render" );
+        },
+        [this]( int packet )
+        {
+            profiler.BeginGpuFrame();
+            ProfileScope scope( profiler, "RenderFrame" );
+            DrawFrame( packets[packet] );
+        },
+        [this]()
+        {
+            MakeContextCurrent( false );
+        } );
+    }
+
+
+    // Waits for the frames in flight and takes the GL context back.
+    private: void StopRenderThread()
+    {
+        renderThread.Stop();
+        MakeContextCurrent( true );
+    }
+
+
+    private: void CollectRunStats( int frameCount )
     {
-        if ( glfwGetKey( window, GLFW_KEY_ESCAPE ) == GLFW_PRESS )
+        // Wait for the GPU so the measured time covers all submitted frames.
+        glFinish();
+        runStats.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+        runStats.frames = frameCount;
+        runStats.renderCpuSeconds = recordCpuSeconds + submitCpuSeconds;
+        runStats.packetWaitSeconds = renderThread.acquireWaitSeconds;
+        runStats.renderIdleSeconds = renderThread.renderIdleSeconds;
+        runStats.limiterSeconds = pacer.sleepSeconds + pacer.spinSeconds;
+        runStats.gpuWaitSeconds = pacer.gpuWaitSeconds;
+        runStats.simulationSteps = timestep.steps;
+        runStats.simulationDroppedSeconds = timestep.droppedSeconds;
+        if ( resolutionScaler.frames > 0 )
+            runStats.renderScale = resolutionScaler.scaleTotal / resolutionScaler.frames;
+        runStats.renderScaleChanges = resolutionScaler.changes;
+        runStats.renderScaleShrinksUndone = resolutionScaler.shrinksUndone;
+        if ( resolutionScaler.samples > 0 )
+        {
+            runStats.gpuFrameMs = resolutionScaler.gpuMsTotal / resolutionScaler.samples;
+            runStats.cpuFrameMs = resolutionScaler.cpuMsTotal / resolutionScaler.samples;
+        }
+        runStats.cpuTimedFrames = resolutionScaler.cpuTimedFrames;
+        runStats.drawCalls = renderQueue.drawCalls + quadBatch.drawCalls;
+        runStats.commandsDrawn = renderQueue.commandsDrawn;
+        runStats.programBinds = renderQueue.programBinds;
+        runStats.vaoBinds = renderQueue.vaoBinds;
+        runStats.uniformUpdates = renderQueue.uniformUpdates;
+        runStats.materialBinds = renderQueue.materialBinds;
+        runStats.objectsTested = objectsTested;
+        runStats.objectsVisible = objectsVisible;
+        runStats.cullSeconds = cullSeconds;
+        runStats.objectsOccluded = occlusionCuller.objectsOccluded;
+        runStats.occlusionSeconds = occlusionSeconds;
+        runStats.trianglesSubmitted = trianglesSubmitted;
+        runStats.glStateCalls = GLStateCache::total;
+        runStats.renderer = (const char*) glGetString( GL_RENDERER );
+        if ( profiler.enabled )
+        {
+            profiler.Flush();
+            runStats.scopes = profiler.GetStats();
+        }
+    }
+
+
+    private: void ReportProfile()
+    {
+        profiler.Flush();
+        profiler.Report( std::cout );
+        if ( !settings.traceFile.empty() && profiler.WriteChromeTrace( settings.traceFile ) )
+            std::cout << "Saved trace to " << settings.traceFile << std::endl;
+    }
+
+
+    private: void ReportHeadlessRun( int frameCount )
+    {
+        double seconds = runStats.seconds;
+        std::cout << "Simulation: " << timestep.steps << " steps at " << 1.0 / timestep.stepSeconds << " Hz ("
+                  << (double) timestep.steps / frameCount << " per frame), " << timestep.framesClamped << " frames clamped to "
+                  << timestep.maxSteps << " steps, " << timestep.droppedSeconds << " s dropped" << std::endl;
+        if ( !settings.rendering )
+        {
+            std::cout << "Simulated " << timestep.steps << " steps in " << seconds << " s ("
+                      << timestep.steps / seconds << " steps/s) without rendering" << std::endl;
+            return;
+        }
+        std::cout << "Rendered " << frameCount << " frames in " << seconds << " s ("
+                  << frameCount / seconds << " fps, " << seconds * 1000.0 / frameCount << " ms/frame)" << std::endl;
+        std::cout << "Draw calls per frame: " << (double) runStats.drawCalls / frameCount
+                  << ", CPU render time: " << runStats.renderCpuSeconds * 1000.0 / frameCount << " ms/frame" << std::endl;
+        if ( settings.renderThread )
+            std::cout << "Render thread: " << recordCpuSeconds * 1000.0 / frameCount << " ms/frame recording, "
+                      << submitCpuSeconds * 1000.0 / frameCount << " ms/frame submitting; main waited " << runStats.packetWaitSeconds * 1000.0 / frameCount
+                      << " ms/frame for a packet, render thread idle " << runStats.renderIdleSeconds * 1000.0 / frameCount << " ms/frame" << std::endl;
+        std::cout << "Frame pacing: ";
+        if ( pacer.GetMaxFps() > 0.0 )
+            std::cout << pacer.GetMaxFps() << " fps limit held back " << pacer.limitedFrames << " frames (" << pacer.sleepSeconds * 1000.0 / frameCount
+                      << " ms/frame asleep, " << pacer.spinSeconds * 1000.0 / frameCount << " spinning), ";
+        std::cout << pacer.GetFramesInFlight() << " frames in flight, " << pacer.gpuWaits << " GPU waits ("
+                  << pacer.gpuWaitSeconds * 1000.0 / frameCount << " ms/frame)" << std::endl;
+        // Without a scene target, dynamic resolution never ran.
+        if ( resolutionScaler.frames > 0 )
+            std::cout << "Dynamic resolution: " << resolutionScaler.targetMs << " ms GPU target, scale " << resolutionScaler.minScale << "-"
+                      << resolutionScaler.maxScale << ", average " << runStats.renderScale << " (last " << resolutionScaler.scale << ", "
+                      << resolutionScaler.changes << " changes, " << resolutionScaler.shrinksUndone << " shrinks undone), GPU " << runStats.gpuFrameMs << " ms/frame, CPU "
+                      << runStats.cpuFrameMs << " ms/frame over " << resolutionScaler.samples << " samples, "
+                      << runStats.cpuTimedFrames << " frames timed on the CPU" << std::endl;
+        std::cout << "Render queue: " << renderQueue.commandsDrawn << " commands in " << renderQueue.drawCalls << " draw calls ("
+                  << SubmitModeName() << "), " << renderQueue.programBinds << " program binds (" << renderQueue.programBindsSkipped << " skipped), "
+                  << renderQueue.vaoBinds << " VAO binds (" << renderQueue.vaoBindsSkipped << " skipped)" << std::endl;
+        std::cout << "Stream buffer (" << ( quadBatch.instanceBuffer.persistent ? "persistent" : "unsynchronized map" ) << "): "
+                  << quadBatch.instanceBuffer.fenceWaits << " fence waits (" << quadBatch.instanceBuffer.fenceWaitSeconds * 1000.0 << " ms), "
+                  << quadBatch.instanceBuffer.orphans << " orphans, " << quadBatch.instanceBuffer.resizes << " resizes, " << quadBatch.quadsDropped << " quads dropped" << std::endl;
+        std::cout << "GL state calls per frame: " << (double) GLStateCache::total.issued / frameCount << " issued, "
+                  << (double) GLStateCache::total.filtered / frameCount << " filtered" << std::endl;
+        std::cout << "Mesh pools: " << meshes.GetMeshCount() << " meshes, " << meshes.GetFreeRangeCount() << " free ranges" << std::endl;
+        if ( culls > 0 )
+        {
+            std::cout << "Frustum culling (";
+            if ( settings.hierarchicalCulling )
+                std::cout << "BVH, height " << benchBvh.GetHeight();
+            else
+                std::cout << FrustumCuller::ModeName( culler.mode ) << ", " << culler.GetThreadCount() << " threads";
+            std::cout << "): " << (double) objectsVisible / culls << " of " << (double) objectsTested / culls
+                      << " objects visible, " << cullSeconds * 1000.0 / culls << " ms/frame" << std::endl;
+        }
+        if ( occlusionCuller.objectsTested > 0 )
+            std::cout << "Occlusion culling (" << occlusionCuller.GetWidth() << "x" << occlusionCuller.GetHeight() << " depth): "
+                      << (double) occlusionCuller.objectsOccluded / frameCount << " of " << (double) occlusionCuller.objectsTested / frameCount
+                      << " objects hidden, " << occlusionSeconds * 1000.0 / frameCount << " ms/frame" << std::endl;
+        if ( lodSelector.selections > 0 )
+        {
+            std::cout << "Level of detail (" << lodSelector.pixelError << " px): " << (double) trianglesSubmitted / frameCount << " triangles/frame, selections per level";
+            int levels = Mesh::MAX_LODS;
+            while ( lodSelector.selectionsPerLevel[levels - 1] == 0 )
+                levels--;
+            for ( int level = 0; level < levels; level++ )
+                std::cout << " " << lodSelector.selectionsPerLevel[level];
+            std::cout << ", " << lodSelector.levelChanges << " level changes" << std::endl;
+        }
+        std::cout << "Largest mesh: " << runStats.largestMeshTriangles << " triangles, ACMR " << runStats.meshCacheBefore.acmr << " -> "
+                  << runStats.meshCacheAfter.acmr << ", ATVR " << runStats.meshCacheBefore.atvr << " -> " << runStats.meshCacheAfter.atvr << std::endl;
+
+        if ( !settings.captureFile.empty() && headlessContext.SaveFramebufferToFile( settings.captureFile ) )
+            std::cout << "Saved last frame to " << settings.captureFile << std::endl;
+    }
+
+
+    private: const char* SubmitModeName() const
+    {
+        if ( renderQueue.submitMode == RenderQueue::SUBMIT_PER_DRAW )
+            return "per draw";
+        if ( renderQueue.submitMode == RenderQueue::SUBMIT_MULTI_DRAW || !renderQueue.IsIndirectAvailable() )
+            return "multi-draw";
+        return "multi-draw indirect";
+    }
+
+
+    private: void LoadInput()
+    {
+        inputMap.BindKey( GLFW_KEY_ESCAPE, ACTION_QUIT );
+        inputMap.BindKey( GLFW_KEY_X, ACTION_SHOW_RECTANGLE );
+        inputMap.BindKey( GLFW_KEY_Z, ACTION_SWAP_SHADER );
+
+        glfwSetKeyCallback( window, []( GLFWwindow* window, int key, int /*scancode*/, int action, int mods )
+        {
+            // Repeats are not state changes.
+            if ( action != GLFW_REPEAT )
+                GetEngine( window )->PushInputEvent( InputEvent::KEY, key, action == GLFW_PRESS, mods, 0.0f, 0.0f );
+        } );
+        glfwSetMouseButtonCallback( window, []( GLFWwindow* window, int button, int action, int mods )
+        {
+            GetEngine( window )->PushInputEvent( InputEvent::MOUSE_BUTTON, button, action == GLFW_PRESS, mods, 0.0f, 0.0f );
+        } );
+        glfwSetCursorPosCallback( window, []( GLFWwindow* window, double x, double y )
+        {
+            GetEngine( window )->PushInputEvent( InputEvent::CURSOR, 0, false, 0, (float) x, (float) y );
+        } );
+        glfwSetScrollCallback( window, []( GLFWwindow* window, double x, double y )
+        {
+            GetEngine( window )->PushInputEvent( InputEvent::SCROLL, 0, false, 0, (float) x, (float) y );
+        } );
+    }
+
+
+    private: static BananaEngine* GetEngine( GLFWwindow* window )
+    {
+        return (BananaEngine*) glfwGetWindowUserPointer( window );
+    }
+
+
+    private: void PushInputEvent( int type, int code, bool pressed, int mods, float x, float y )
+    {
+        InputEvent event;
+        event.time = glfwGetTime();
+        event.type = type;
+        event.code = code;
+        event.pressed = pressed;
+        event.mods = mods;
+        event.x = x;
+        event.y = y;
+        inputQueue.Push( event );
+    }
+
+
+    // Applies the input events up to until to the actions, for the step about to run.
+    private: void HandleInput( double until )
+    {
+        inputMap.BeginStep();
+        inputMap.Consume( inputQueue, until );
+        if ( inputMap.WasPressed( ACTION_QUIT ) && window != nullptr )
             glfwSetWindowShouldClose( window, true );
-        x = glfwGetKey( window, GLFW_KEY_X ) == GLFW_PRESS;
-        z = glfwGetKey( window, GLFW_KEY_Z ) == GLFW_PRESS;
+        x = inputMap.IsActive( ACTION_SHOW_RECTANGLE );
+        z = inputMap.IsActive( ACTION_SWAP_SHADER );
+    }
+
+
+    // Both states start out as the scene's first frame.
+    private: void InitSimulation()
+    {
+        timestep.Init( settings.simulationHz, settings.maxSimulationSteps );
+        for ( SimulationState& state : simulationStates )
+        {
+            state.time = 0.0;
+            state.quadRotations.resize( settings.quadCount );
+            for ( int i = 0; i < settings.quadCount; i++ )
+                state.quadRotations[i] = i * 0.01f;
+        }
+        currentState = 0;
     }
 
 
-    private: void Render()
+    // One fixed-length update: the older state is overwritten with the next one.
+    private: void StepSimulation()
     {
-        glClearColor( 0.2f, 0.3f, 0.3f, 1.0f );
-        glClear( GL_COLOR_BUFFER_BIT );
+        const SimulationState& previous = simulationStates[currentState];
+        currentState ^= 1;
+        SimulationState& next = simulationStates[currentState];
+        float step = (float) timestep.stepSeconds;
+        next.time = previous.time + timestep.stepSeconds;
+        jobs.ParallelFor( 0, settings.quadCount, 16384, [&]( int begin, int end )
+        {
+            for ( int i = begin; i < end; i++ )
+                next.quadRotations[i] = previous.quadRotations[i] + QUAD_SPIN * step;
+        } );
+    }
 
-        if ( z ) 
-            shader->SetFloat4( "renderColor", sin( time*2.0+M_PI )*0.5+0.5, sin( time*2.0 )*0.5+0.5, 0.0, 1.0 );
-        
-        // glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-        if ( x )
-            DrawRectangle();
+
+    // Blends the last two simulation states by how far real time is into the next step.
+    private: void InterpolateSimulation( FramePacket& packet )
+    {
+        const SimulationState& previous = simulationStates[currentState ^ 1];
+        const SimulationState& current = simulationStates[currentState];
+        float alpha = timestep.GetAlpha();
+        time = (float) ( previous.time + ( current.time - previous.time ) * alpha );
+        packet.quadRotations.resize( settings.quadCount );
+        for ( int i = 0; i < settings.quadCount; i++ )
+            packet.quadRotations[i] = previous.quadRotations[i] + ( current.quadRotations[i] - previous.quadRotations[i] ) * alpha;
+    }
+
+
+    // Main thread half of a frame: everything up to a sorted draw list, without touching GL.
+    private: void RecordFrame( FramePacket& packet, int frameCount )
+    {
+        auto start = std::chrono::steady_clock::now();
+        InterpolateSimulation( packet );
+        packet.constants = MakeFrameConstants( frameCount );
+        packet.cullFace = false;
+        packet.quadField = settings.quadCount > 0;
+        if ( !packet.quadField )
+        {
+            {
+                ProfileScope scope( profiler, "Record" );
+                // glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+                if ( settings.triangleCount > 0 || settings.rectangleCount > 0 )
+                    DrawBenchScene( packet );
+                else if ( sphereMesh >= 0 )
+                    DrawSphere( packet );
+                else if ( x )
+                    DrawRectangle();
+                else
+                    DrawTriangle();
+            }
+            {
+                ProfileScope scope( profiler, "Sort" );
+                renderQueue.Sort();
+            }
+            renderQueue.Swap( packet.drawList );
+        }
+        recordCpuSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+
+    // GL half of a frame, on whichever thread owns the context.
+    private: void DrawFrame( FramePacket& packet )
+    {
+        auto drawStart = std::chrono::steady_clock::now();
+        {
+            ProfileScope scope( profiler, "WaitForGpu" );
+            pacer.WaitForFrameSlot();
+        }
+        BeginScene( packet.constants );
+        UploadFrameConstants( packet.constants );
+        UpdateShaderLoading();
+        {
+            ProfileScope scope( profiler, "Render" );
+            GpuProfileScope gpuScope( profiler, "Render" );
+            auto start = std::chrono::steady_clock::now();
+            GLStateCache::ClearColor( 0.2f, 0.3f, 0.3f, 1.0f );
+            glClear( GL_COLOR_BUFFER_BIT );
+            GLStateCache::SetEnabled( GL_CULL_FACE, packet.cullFace );
+            if ( packet.quadField )
+                DrawQuadField( packet.quadRotations );
+            else
+            {
+                ProfileScope scope( profiler, "Submit" );
+                renderQueue.Execute( packet.drawList );
+            }
+            submitCpuSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        }
+        EndScene();
+        // The swap is left out: with vsync it waits for the display, not for the frame's work.
+        drawFrameMs = (float) ( std::chrono::duration<double>( std::chrono::steady_clock::now() - drawStart ).count() * 1000.0 );
+        Present();
+        pacer.EndFrame();
+        GLStateCache::EndFrame();
+    }
+
+
+    // Without a frame rate to aim for, the GPU gets a 60 Hz frame.
+    private: void LoadSceneTarget()
+    {
+        float targetMs = settings.targetGpuMs;
+        if ( targetMs <= 0.0f )
+            targetMs = (float) ( 1000.0 / ( settings.maxFps > 0.0 ? settings.maxFps : 60.0 ) );
+        if ( sceneTarget.Init( framebufferWidth.load(), framebufferHeight.load() ) == 0 )
+        {
+            gpuFrameTimer.Init();
+            resolutionScaler.Init( settings.minRenderScale, settings.maxRenderScale, targetMs );
+        }
         else
-            DrawTriangle();
+            sceneTarget.Unload();
+        // Init() left the target bound, or deleted it; either way the display is what gets
+        // drawn to until the first frame, and for good without a target.
+        GLStateCache::BindFramebuffer( GL_FRAMEBUFFER, settings.headless ? headlessContext.framebuffer : 0 );
     }
-    
-    
+
+
+    // Takes up the latest window size and binds what the scene draws into: the scene target
+    // at the scaler's resolution, or the window itself.
+    private: void BeginScene( FrameConstants& constants )
+    {
+        displayWidth = framebufferWidth.load( std::memory_order_relaxed );
+        displayHeight = framebufferHeight.load( std::memory_order_relaxed );
+        int width = displayWidth;
+        int height = displayHeight;
+        if ( sceneTarget.framebuffer != 0 )
+        {
+            float scale = resolutionScaler.Update( gpuFrameTimer.BeginFrame(), drawFrameMs );
+            sceneTarget.Resize( (int) std::lround( displayWidth * scale ), (int) std::lround( displayHeight * scale ) );
+            sceneTarget.Bind();
+            width = sceneTarget.width;
+            height = sceneTarget.height;
+            renderScale.store( scale, std::memory_order_relaxed );
+        }
+        else
+            GLStateCache::Viewport( 0, 0, width, height );
+        // A minimized window has no pixels at all.
+        constants.viewport[0] = (float) width;
+        constants.viewport[1] = (float) height;
+        constants.viewport[2] = 1.0f / std::max( width, 1 );
+        constants.viewport[3] = 1.0f / std::max( height, 1 );
+    }
+
+
+    private: void EndScene()
+    {
+        if ( sceneTarget.framebuffer == 0 )
+            return;
+        {
+            ProfileScope scope( profiler, "Upscale" );
+            sceneTarget.BlitTo( settings.headless ? headlessContext.framebuffer : 0, displayWidth, displayHeight );
+        }
+        gpuFrameTimer.EndFrame();
+    }
+
+
+    // All static meshes share the pools of their vertex format, and with them one VAO.
+    private: void LoadMeshes()
+    {
+        colorVertexFormat = meshes.RegisterFormat( settings.compactVertices ? VertexFormat( COMPACT_COLOR_VERTEX ) : VertexFormat( COLOR_VERTEX ) );
+
+        std::vector<int> churnMeshes;
+        AddChurnMeshes( churnMeshes );
+        LoadTriangle();
+        AddChurnMeshes( churnMeshes );
+        LoadRectangle();
+        AddChurnMeshes( churnMeshes );
+        if ( settings.sphereSegments > 0 )
+            LoadSphere( settings.sphereSegments );
+        RemoveChurnMeshes( churnMeshes );
+    }
+
+
+    // Puts settings.meshChurn throwaway meshes in the pools ahead of the next real mesh: odd
+    // 16-bit index counts that leave half-used slots, and the first time one mesh too large
+    // for 16-bit indices, which also makes the pool grow.
+    private: void AddChurnMeshes( std::vector<int>& churnMeshes )
+    {
+        for ( int i = 0; i < settings.meshChurn; i++ )
+        {
+            int vertexCount = churnMeshes.empty() ? 65537 : 3 + (int) churnMeshes.size() % 7;
+            std::vector<unsigned char> vertices( vertexCount * meshes.GetFormat( colorVertexFormat ).Stride() );
+            std::vector<unsigned int> indices( 3 + (int) churnMeshes.size() % 5 * 3 );
+            for ( size_t index = 0; index < indices.size(); index++ )
+                indices[index] = (unsigned int) ( index * 7 % vertexCount );
+            churnMeshes.push_back( meshes.Add( colorVertexFormat, vertices.data(), vertexCount, indices.data(), (int) indices.size() ) );
+        }
+    }
+
+
+    // Takes the throwaway meshes out again and packs the real ones together, so every real
+    // mesh is drawn from where Defragment() moved it. Frames must come out as without churn.
+    private: void RemoveChurnMeshes( const std::vector<int>& churnMeshes )
+    {
+        if ( churnMeshes.empty() )
+            return;
+        for ( int mesh : churnMeshes )
+            meshes.Remove( mesh );
+        int fragmented = meshes.GetFreeRangeCount();
+        meshes.Defragment();
+        std::cout << "Mesh churn: removed " << churnMeshes.size() << " meshes, " << fragmented << " free ranges, "
+                  << meshes.GetFreeRangeCount() << " after defragmenting" << std::endl;
+    }
+
+
     private: void LoadTriangle()
     {
-        float vertices[] = {
+        std::vector<float> vertices = {
             -0.5f, -0.5f, 0.0f,  1.0f, 0.0f, 0.0f,
             0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f,
             0.0f,  0.5f, 0.0f,  0.0f, 0.0f, 1.0f,
         };
-        glGenVertexArrays( 1, &triangleVAO );
-        glBindVertexArray( triangleVAO );
-        glGenBuffers( 1, &triangleVBO );
-        glBindBuffer( GL_ARRAY_BUFFER, triangleVBO );
-        glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
-        glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 6*sizeof( float ), (void*)0 );
-        glEnableVertexAttribArray( 0 );
-        glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 6*sizeof( float ), (void*)( 3 * sizeof( float ) ) );
-        glEnableVertexAttribArray( 1 );
-
-        glBindVertexArray( 0 );
+        std::vector<unsigned int> indices = {
+            0,  1,  2,
+        };
+        triangleMesh = AddMesh( colorVertexFormat, vertices, indices );
     }
 
 
     private: void LoadRectangle()
     {
-        float vertices[] = {
+        std::vector<float> vertices = {
             -0.5f,  0.5f, 0.0f,  0.0f, 1.0f, 0.8f,
             0.5f,  0.5f, 0.0f,  1.0f, 0.0f, 0.0f,
             0.5f, -0.5f, 0.0f,  0.8f, 1.0f, 0.0f,
             -0.5f, -0.5f, 0.0f,  0.0f, 0.0f, 1.0f,
         };
-        unsigned int indices[] = {
-            0,  1,  2,
-            2,  3,  0,
+        // Counter-clockwise, like the other meshes, so it survives back-face culling.
+        std::vector<unsigned int> indices = {
+            0,  3,  2,
+            2,  1,  0,
         };
+        rectangleMesh = AddMesh( colorVertexFormat, vertices, indices );
+        // Kept on the CPU for the occlusion culler; AddMesh leaves them in the uploaded order.
+        rectangleVertices = vertices;
+        rectangleIndices = indices;
+    }
+
+
+    // A UV sphere colored by its normals, with triangles and vertices shuffled the way an
+    // unprocessed export might leave them, so the mesh optimizer has something to fix.
+    private: void LoadSphere( int segments )
+    {
+        int rings = std::max( segments / 2, 2 );
+        std::vector<float> vertices;
+        for ( int ring = 0; ring <= rings; ring++ )
+        {
+            float polar = 3.14159265f * ring / rings;
+            for ( int segment = 0; segment <= segments; segment++ )
+            {
+                float azimuth = 2.0f * 3.14159265f * segment / segments;
+                float normal[3] = { std::sin( polar ) * std::cos( azimuth ), std::cos( polar ), std::sin( polar ) * std::sin( azimuth ) };
+                for ( int axis = 0; axis < 3; axis++ )
+                    vertices.push_back( normal[axis] * SPHERE_RADIUS );
+                for ( int axis = 0; axis < 3; axis++ )
+                    vertices.push_back( normal[axis] * 0.5f + 0.5f );
+            }
+        }
+
+        std::vector<unsigned int> indices;
+        for ( int ring = 0; ring < rings; ring++ )
+            for ( int segment = 0; segment < segments; segment++ )
+            {
+                unsigned int a = ring * ( segments + 1 ) + segment;
+                unsigned int b = a + segments + 1;
+                // Counter-clockwise seen from outside; the pole rows would be degenerate.
+                if ( ring > 0 )
+                    indices.insert( indices.end(), { a, b, a + 1 } );
+                if ( ring < rings - 1 )
+                    indices.insert( indices.end(), { a + 1, b, b + 1 } );
+            }
+
+        // Fixed seed, so every run and every benchmark sees the same input.
+        std::mt19937 random( 1 );
+        size_t vertexCount = vertices.size() / 6;
+        std::vector<unsigned int> order( vertexCount );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            order[v] = (unsigned int) v;
+        std::shuffle( order.begin(), order.end(), random );
+        std::vector<float> shuffled( vertices.size() );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            std::copy( &vertices[v * 6], &vertices[v * 6] + 6, &shuffled[order[v] * 6] );
+        for ( unsigned int& index : indices )
+            index = order[index];
+        std::vector<size_t> triangles( indices.size() / 3 );
+        for ( size_t t = 0; t < triangles.size(); t++ )
+            triangles[t] = t;
+        std::shuffle( triangles.begin(), triangles.end(), random );
+        std::vector<unsigned int> shuffledIndices;
+        shuffledIndices.reserve( indices.size() );
+        for ( size_t t : triangles )
+            shuffledIndices.insert( shuffledIndices.end(), &indices[t * 3], &indices[t * 3] + 3 );
+
+        sphereMesh = AddMesh( colorVertexFormat, shuffled, shuffledIndices );
+    }
+
+
+    // Runs the mesh through MeshOptimizer unless settings.optimizeMeshes is off, then adds it
+    // to the format's pool. vertices holds the format's source floats with the position first;
+    // both vectors are reordered in place.
+    private: int AddMesh( int format, std::vector<float>& vertices, std::vector<unsigned int>& indices )
+    {
+        const VertexFormat& layout = meshes.GetFormat( format );
+        size_t floatsPerVertex = layout.SourceComponents();
+        size_t vertexCount = vertices.size() / floatsPerVertex;
+        VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache( indices, vertexCount );
+        if ( settings.optimizeMeshes )
+        {
+            MeshOptimizer::OptimizeVertexCache( indices, vertexCount );
+            MeshOptimizer::OptimizeOverdraw( indices, vertices.data(), floatsPerVertex, vertexCount );
+            vertexCount = MeshOptimizer::OptimizeVertexFetch( indices, vertices.data(), vertexCount, floatsPerVertex * sizeof( float ) );
+        }
+        VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache( indices, vertexCount );
+
+        size_t triangleCount = indices.size() / 3;
+        if ( triangleCount > runStats.largestMeshTriangles )
+        {
+            runStats.largestMeshTriangles = triangleCount;
+            runStats.meshCacheBefore = before;
+            runStats.meshCacheAfter = after;
+        }
+
+        std::vector<unsigned int> allIndices = indices;
+        std::vector<MeshLod> lods( 1 );
+        lods[0].indexCount = (int) indices.size();
+        if ( settings.lod && triangleCount >= LOD_MIN_TRIANGLES )
+            BuildLods( vertices, floatsPerVertex, vertexCount, allIndices, lods );
+
+        std::vector<unsigned char> packed = layout.Pack( vertices.data(), (int) vertexCount );
+        int mesh = meshes.Add( format, packed.data(), (int) vertexCount, allIndices.data(), lods.data(), (int) lods.size() );
+        if ( triangleCount >= 1024 && meshes.IsValid( mesh ) )
+        {
+            std::cout << "Mesh " << mesh << ": " << triangleCount << " triangles, " << vertexCount << " vertices, "
+                      << ( meshes.Get( mesh ).indexType == GL_UNSIGNED_SHORT ? 16 : 32 ) << "-bit indices, ACMR "
+                      << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+            if ( lods.size() > 1 )
+            {
+                std::cout << "Mesh " << mesh << " levels of detail (triangles @ error):";
+                for ( const MeshLod& lod : lods )
+                    std::cout << " " << lod.indexCount / 3 << " @ " << lod.error;
+                std::cout << std::endl;
+            }
+        }
+        return mesh;
+    }
+
+
+    // Appends coarser levels to allIndices, each simplified from the one before to about half
+    // its triangles, until the next level would be tiny or simplification stalls. Errors add
+    // up along the chain, so each level's error bounds its distance from the full mesh.
+    private: void BuildLods( const std::vector<float>& vertices, size_t floatsPerVertex, size_t vertexCount,
+                             std::vector<unsigned int>& allIndices, std::vector<MeshLod>& lods )
+    {
+        std::vector<unsigned int> previous = allIndices;
+        while ( (int) lods.size() < Mesh::MAX_LODS && previous.size() / 6 >= LOD_MIN_TRIANGLES / 4 )
+        {
+            float error = 0.0f;
+            std::vector<unsigned int> level = MeshOptimizer::Simplify( previous, vertices.data(), floatsPerVertex, vertexCount,
+                                                                       previous.size() / 6 * 3, FLT_MAX, &error );
+            if ( level.size() > previous.size() * 3 / 4 )
+                break;
+            MeshOptimizer::OptimizeVertexCache( level, vertexCount );
+
+            MeshLod lod;
+            lod.indexOffset = (int) allIndices.size();
+            lod.indexCount = (int) level.size();
+            lod.error = lods.back().error + error;
+            lods.push_back( lod );
+            allIndices.insert( allIndices.end(), level.begin(), level.end() );
+            previous.swap( level );
+        }
+    }
+
+
+    private: DrawCommand MakeMeshCommand( int mesh, Shader* shader, int lod = 0 )
+    {
+        const Mesh& range = meshes.Get( mesh );
+        DrawCommand command;
+        command.shader = shader;
+        command.vao = range.vao;
+        command.first = range.firstIndex + range.lods[lod].indexOffset;
+        command.count = range.lods[lod].indexCount;
+        command.baseVertex = range.baseVertex;
+        command.indexType = range.indexType;
+        return command;
+    }
+
+
+    // The shaders find these blocks by name, so register them before any program loads.
+    private: void LoadUniformBuffers()
+    {
+        Shader::RegisterUniformBlock( "FrameConstants", FRAME_CONSTANTS_BINDING, sizeof( FrameConstants ) );
+        Shader::RegisterUniformBlock( "MaterialConstants", MATERIAL_CONSTANTS_BINDING, sizeof( MaterialConstants ) );
+
+        frameUniforms.Init( FRAME_CONSTANTS_BINDING, sizeof( FrameConstants ) );
+        frameUniforms.Bind();
+
+        // A fixed palette; materials only differ in tint and pulse speed for now.
+        materialUniforms.Init( MATERIAL_CONSTANTS_BINDING, sizeof( MaterialConstants ), MAX_MATERIALS );
+        for ( int i = 0; i < MAX_MATERIALS; i++ )
+        {
+            MaterialConstants material = {};
+            material.color[0] = 0.4f + 0.6f * ( i % 7 ) / 6.0f;
+            material.color[1] = 0.4f + 0.6f * ( i % 5 ) / 4.0f;
+            material.color[2] = 0.4f + 0.6f * ( i % 3 ) / 2.0f;
+            material.color[3] = 1.0f;
+            material.parameters[0] = 1.0f + ( i % 4 );
+            materialUniforms.Set( i, &material );
+        }
+        materialUniforms.Upload();
+        renderQueue.materials = &materialUniforms;
+    }
+
+
+    private: void UnloadUniformBuffers()
+    {
+        renderQueue.materials = nullptr;
+        frameUniforms.Unload();
+        materialUniforms.Unload();
+    }
 
-        glGenVertexArrays( 1, &rectangleVAO );
-        glBindVertexArray( rectangleVAO );
-        glGenBuffers( 1, &rectangleVBO );
-        glBindBuffer( GL_ARRAY_BUFFER, rectangleVBO );
-        glBufferData( GL_ARRAY_BUFFER, sizeof( vertices ), vertices, GL_STATIC_DRAW );
 
-        glGenBuffers( 1, &rectangleEBO );
-        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, rectangleEBO );
-        glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( indices ), indices, GL_STATIC_DRAW );
+    // One upload per frame for everything the programs share.
+    private: FrameConstants MakeFrameConstants( int frameCount )
+    {
+        FrameConstants constants = {};
+        constants.time[0] = time;
+        constants.time[1] = frameCount > 0 ? time - lastFrameTime : 0.0f;
+        constants.time[2] = (float) frameCount;
+        lastFrameTime = time;
+        return constants;
+    }
 
-        glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 6*sizeof( float ), (void*)0 );
-        glEnableVertexAttribArray( 0 );
-        glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 6*sizeof( float ), (void*)( 3 * sizeof( float ) ) );
-        glEnableVertexAttribArray( 1 );
 
-        glBindVertexArray( 0 );
+    private: void UploadFrameConstants( const FrameConstants& constants )
+    {
+        frameUniforms.Set( 0, &constants );
+        frameUniforms.Upload();
+        frameUniforms.Bind();
+        materialUniforms.Upload();
     }
 
 
     private: void LoadShaders()
     {
-        shader = new Shader( "./Shaders/shader.vertex", "./Shaders/shader.frag" );
-        shader2 = new Shader( "./Shaders/shader.vertex", "./Shaders/shader2.frag" );
+        // The fallback is tiny and built up front so the first frame always has a program.
+        fallbackShader = new Shader( "./Shaders/shader.vertex", "./Shaders/fallback.frag" );
+        shader = shaderBatch.Add( "./Shaders/shader.vertex", "./Shaders/shader.frag", fallbackShader );
+        shader2 = shaderBatch.Add( "./Shaders/shader.vertex", "./Shaders/shader2.frag", fallbackShader );
+        instancedShader = shaderBatch.Add( "./Shaders/instanced.vertex", "./Shaders/shader2.frag", fallbackShader );
+        if ( settings.triangleCount > 0 || settings.rectangleCount > 0 )
+            for ( int i = 0; i < std::max( settings.shaderCount, 1 ); i++ )
+                benchShaders.push_back( shaderBatch.Add( "./Shaders/bench.vertex", settings.materialCount > 0 ? "./Shaders/material.frag" : "./Shaders/shader2.frag", fallbackShader ) );
+        shaderBatch.Submit();
+    }
+
+
+    private: void UpdateShaderLoading()
+    {
+        if ( shaderBatch.IsDone() )
+            return;
+        if ( shaderBatch.Poll() == 0 )
+            OnShadersLoaded();
+    }
+
+
+    private: void FinishShaderLoading()
+    {
+        shaderBatch.Wait();
+        OnShadersLoaded();
+    }
+
+
+    private: void OnShadersLoaded()
+    {
+        // Without per-object updates every benchmark object shares this small centered transform.
+        benchTransformHandles.clear();
+        for ( Shader* benchShader : benchShaders )
+        {
+            benchTransformHandles.push_back( benchShader->GetUniformHandle( "transform" ) );
+            benchShader->Use();
+            benchShader->SetFloat4( benchTransformHandles.back(), 0.0f, 0.0f, 0.1f, 0.0f );
+        }
+        shadersLoaded = true;
     }
 
 
     private: void UnloadShaders()
     {
+        shaderBatch.Wait();
         delete shader;
         delete shader2;
+        delete instancedShader;
+        for ( Shader* benchShader : benchShaders )
+            delete benchShader;
+        benchShaders.clear();
+        delete fallbackShader;
     }
 
 
     private: void DrawTriangle()
     {
-        if ( z )
-            shader->Use();
+        DrawCommand command = MakeMeshCommand( triangleMesh, z ? shader : shader2 );
+        renderQueue.Submit( RenderQueue::MakeKey( RenderQueue::PASS_OPAQUE, command, 0, 0.0f ), command );
+    }
+
+
+    private: void DrawRectangle()
+    {
+        DrawCommand command = MakeMeshCommand( rectangleMesh, z ? shader : shader2 );
+        renderQueue.Submit( RenderQueue::MakeKey( RenderQueue::PASS_OPAQUE, command, 0, 0.0f ), command );
+    }
+
+
+    private: void DrawSphere( FramePacket& packet )
+    {
+        // Only the near side, so the image does not depend on the triangle order.
+        packet.cullFace = true;
+        DrawCommand command = MakeMeshCommand( sphereMesh, shader2, SelectLod( 0, sphereMesh, 1.0f ) );
+        trianglesSubmitted += command.count / 3;
+        renderQueue.Submit( RenderQueue::MakeKey( RenderQueue::PASS_OPAQUE, command, 0, 0.0f ), command );
+    }
+
+
+    // Fills the screen with a grid of spinning quads.
+    private: void DrawQuadField( const std::vector<float>& rotations )
+    {
+        instancedShader->Use();
+        quadBatch.BeginFrame();
+
+        int columns = (int) ceil( sqrt( (double) settings.quadCount ) );
+        float cellSize = 2.0f / columns;
+        for ( int i = 0; i < settings.quadCount; i++ )
+        {
+            QuadInstance quad;
+            quad.x = -1.0f + ( i % columns + 0.5f ) * cellSize;
+            quad.y = -1.0f + ( i / columns + 0.5f ) * cellSize;
+            quad.scaleX = cellSize * 0.7f;
+            quad.scaleY = cellSize * 0.7f;
+            quad.rotation = rotations[i];
+            quad.r = ( i % 7 ) / 6.0f;
+            quad.g = ( i % 5 ) / 4.0f;
+            quad.b = ( i % 3 ) / 2.0f;
+            quad.a = 1.0f;
+            quadBatch.Add( quad );
+        }
+
+        if ( settings.perObjectQuads )
+            quadBatch.FlushPerObject();
         else
-            shader2->Use();
+            quadBatch.Flush();
+        quadBatch.EndFrame();
+    }
 
-        glBindVertexArray( triangleVAO );
-        glDrawArrays( GL_TRIANGLES, 0, 3 );
-        glBindVertexArray( 0 );
+
+    // Bounding spheres of the benchmark objects: a grid sceneScale screens wide when every
+    // object has its own transform, otherwise all of them at the shared centered transform.
+    private: void LoadBenchBounds()
+    {
+        int objectCount = settings.triangleCount + settings.rectangleCount;
+        int columns = (int) ceil( sqrt( (double) objectCount ) );
+        float cellSize = 2.0f * settings.sceneScale / columns;
+        benchBounds.Clear();
+        std::vector<Aabb> boxes;
+        for ( int i = 0; i < objectCount; i++ )
+        {
+            // The triangle and rectangle fit in a unit square around the origin.
+            float radius = sphereMesh >= 0 && i < settings.triangleCount ? SPHERE_RADIUS : 0.7072f;
+            if ( settings.uniformUpdates )
+                benchBounds.Add( -settings.sceneScale + ( i % columns + 0.5f ) * cellSize, -settings.sceneScale + ( i / columns + 0.5f ) * cellSize,
+                                 0.0f, cellSize * 0.8f * radius );
+            else
+                benchBounds.Add( 0.0f, 0.0f, 0.0f, 0.1f * radius );
+            boxes.push_back( Aabb::FromSphere( benchBounds.x[i], benchBounds.y[i], benchBounds.z[i], benchBounds.radius[i] ) );
+        }
+        if ( settings.hierarchicalCulling )
+            benchBvh.Build( boxes.data(), objectCount );
+        else
+            culler.Init( &jobs );
+        if ( settings.occluderCount > 0 && settings.occlusionCulling )
+            occlusionCuller.Init();
     }
 
 
-    private: void DrawRectangle()
+    // Objects of the benchmark scene in view, in index order, or nullptr when culling is off.
+    private: const uint32_t* CullBenchScene( int& visibleCount )
     {
-        if ( z )
-            shader->Use();
+        if ( !settings.frustumCulling )
+            return nullptr;
+        auto start = std::chrono::steady_clock::now();
+        const uint32_t* visible = nullptr;
+        if ( settings.hierarchicalCulling )
+        {
+            bvhVisible.clear();
+            benchBvh.QueryFrustum( Frustum::ClipCube(), bvhVisible );
+            // Tree order would change the draw order of objects with equal sort keys.
+            std::sort( bvhVisible.begin(), bvhVisible.end() );
+            visible = (const uint32_t*) bvhVisible.data();
+            visibleCount = (int) bvhVisible.size();
+        }
         else
-            shader2->Use();
+        {
+            visible = culler.Cull( benchBounds, Frustum::ClipCube() );
+            visibleCount = culler.GetVisibleCount();
+        }
+        culls++;
+        objectsTested += benchBounds.Size();
+        objectsVisible += visibleCount;
+        cullSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        return visible;
+    }
+
+
+    // Level of detail for object drawn at scale in clip space; the full mesh with lod off.
+    private: int SelectLod( int object, int mesh, float scale )
+    {
+        const Mesh& range = meshes.Get( mesh );
+        if ( !settings.lod || range.lodCount == 1 )
+            return 0;
+        // Pixel error is measured in the pixels actually drawn: the framebuffer's, after resizes
+        // and at high DPI, shrunk by dynamic resolution.
+        int height = (int) ( framebufferHeight.load( std::memory_order_relaxed ) * renderScale.load( std::memory_order_relaxed ) );
+        return lodSelector.Select( object, range, LodSelector::PixelsPerUnit( scale, std::max( height, 1 ) ) );
+    }
+
+
+    // Draws the benchmark triangles and rectangles that survive frustum culling, cycling
+    // through the benchmark programs so the queue has to switch program once per program.
+    // With a sphere loaded, it stands in for the triangles.
+    private: void DrawBenchScene( FramePacket& packet )
+    {
+        int objectCount = settings.triangleCount + settings.rectangleCount;
+        int columns = (int) ceil( sqrt( (double) objectCount ) );
+        float cellSize = 2.0f * settings.sceneScale / columns;
+        float objectScale = settings.uniformUpdates ? cellSize * 0.8f : 0.1f;
+        // Only the spheres' near sides; everything else is counter-clockwise too.
+        packet.cullFace = sphereMesh >= 0;
+        const uint32_t* visible = nullptr;
+        {
+            ProfileScope scope( profiler, "Cull" );
+            visible = CullBenchScene( objectCount );
+        }
+        if ( settings.occluderCount > 0 && settings.occlusionCulling )
+        {
+            ProfileScope scope( profiler, "Occlusion" );
+            objectCount = OccludeBenchScene( visible, objectCount );
+            visible = occlusionVisible.data();
+        }
+        for ( int n = 0; n < objectCount; n++ )
+        {
+            int i = visible ? (int) visible[n] : n;
+            int program = i % (int) benchShaders.size();
+            int mesh = i >= settings.triangleCount ? rectangleMesh : sphereMesh >= 0 ? sphereMesh : triangleMesh;
+            DrawCommand command = MakeMeshCommand( mesh, benchShaders[program], SelectLod( i, mesh, objectScale ) );
+            if ( mesh == sphereMesh )
+                trianglesSubmitted += command.count / 3;
+            if ( settings.materialCount > 0 )
+                command.material = i % std::min( settings.materialCount, MAX_MATERIALS );
+            if ( settings.uniformUpdates && shadersLoaded && program < (int) benchTransformHandles.size() )
+            {
+                command.uniformHandle = benchTransformHandles[program];
+                command.uniformValue[0] = -settings.sceneScale + ( i % columns + 0.5f ) * cellSize;
+                command.uniformValue[1] = -settings.sceneScale + ( i / columns + 0.5f ) * cellSize;
+                command.uniformValue[2] = objectScale;
+            }
+            unsigned int material = command.material >= 0 ? command.material : 0;
+            renderQueue.Submit( RenderQueue::MakeKey( RenderQueue::PASS_OPAQUE, command, material, 0.0f ), command );
+        }
+        DrawOccluders();
+    }
+
+
+    // Wall i of the benchmark scene, a square on a grid over the screen, as x, y and size.
+    private: void GetOccluderPlacement( int i, float& x, float& y, float& size ) const
+    {
+        int columns = (int) ceil( sqrt( (double) settings.occluderCount ) );
+        float cellSize = 2.0f / columns;
+        x = -1.0f + ( i % columns + 0.5f ) * cellSize;
+        y = -1.0f + ( i / columns + 0.5f ) * cellSize;
+        size = cellSize * 0.75f;
+    }
+
+
+    // The walls go in the overlay pass at a nearer depth, in front of everything in the grid.
+    private: void DrawOccluders()
+    {
+        if ( benchShaders.empty() || !shadersLoaded || benchTransformHandles.empty() )
+            return;
+        for ( int i = 0; i < settings.occluderCount; i++ )
+        {
+            DrawCommand command = MakeMeshCommand( rectangleMesh, benchShaders[0] );
+            command.uniformHandle = benchTransformHandles[0];
+            GetOccluderPlacement( i, command.uniformValue[0], command.uniformValue[1], command.uniformValue[2] );
+            command.uniformValue[3] = OCCLUDER_DEPTH;
+            renderQueue.Submit( RenderQueue::MakeKey( RenderQueue::PASS_OVERLAY, command, 0, 0.0f ), command );
+        }
+    }
+
 
-        glBindVertexArray( rectangleVAO );
-        glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );
-        glBindVertexArray( 0 );
+    // Rasterizes the walls into the CPU depth buffer and keeps the candidates not hidden
+    // behind them; candidates is null for all objects. Returns how many survived.
+    private: int OccludeBenchScene( const uint32_t* candidates, int count )
+    {
+        auto start = std::chrono::steady_clock::now();
+        // Everything in the benchmark scene is already in clip space.
+        const float identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+        occlusionCuller.BeginFrame();
+        for ( int i = 0; i < settings.occluderCount; i++ )
+        {
+            float x, y, size;
+            GetOccluderPlacement( i, x, y, size );
+            const float transform[16] = { size, 0, 0, 0,  0, size, 0, 0,  0, 0, 1, 0,  x, y, OCCLUDER_DEPTH, 1 };
+            occlusionCuller.AddOccluder( rectangleVertices.data(), 6, (int) rectangleVertices.size() / 6,
+                                         rectangleIndices.data(), (int) rectangleIndices.size(), transform );
+        }
+        occlusionCuller.Rasterize();
+
+        occlusionVisible.resize( count );
+        if ( candidates == nullptr )
+            for ( int i = 0; i < count; i++ )
+                occlusionVisible[i] = (uint32_t) i;
+        else
+            std::copy( candidates, candidates + count, occlusionVisible.begin() );
+        int visibleCount = occlusionCuller.Filter( benchBounds, occlusionVisible.data(), count, identity, occlusionVisible.data() );
+        occlusionSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        return visibleCount;
     }
 
 
+    // Called on the main thread while the GL context may be on the render thread, so the
+    // new size is only stored; the next frame drawn picks it up.
     private: void OnWindowResized( int width, int height )
     {
-        glViewport(0, 0, width, height);
+        framebufferWidth.store( width, std::memory_order_relaxed );
+        framebufferHeight.store( height, std::memory_order_relaxed );
     }
 
 
@@ -0,0 +1,777 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+#include "banana_engine.cpp"
+
+
+// Runs the engine over a fixed number of frames for each synthetic workload and writes
+// the results as JSON, so numbers from different commits can be diffed or plotted.
+//
+//   banana-bench [--windowed] [--no-render-thread] [--frames-in-flight N] [--frames N] [--width W] [--height H] [--objects N]
+//                [--workload NAME]... [--output FILE]
+//   banana-bench [...] --triangles N --rectangles N --shaders N --materials N --uniform-updates
+//                      --scene-scale F --no-culling --linear-culling --occluders N --no-occlusion
+//                      --sphere N --no-lod --lod-error PX
+//
+// Without --workload every built-in workload runs; --workload picks the ones whose name
+// starts with NAME, e.g. "submit". Any of the scene flags replaces them with a single
+// "custom" workload. The cull-* and bvh-* entries time FrustumCuller and Bvh alone,
+// without GL, on a fixed set of random spheres; jobs-* times the JobSystem's overhead
+// per job.
+struct BenchWorkload
+{
+    std::string name;
+    EngineSettings settings;
+};
+
+
+// The fields the scene flags set; a new scene flag's field belongs here too, or the custom
+// workload never sees it.
+static void CopySceneSettings( const EngineSettings& scene, EngineSettings& settings )
+{
+    settings.triangleCount = scene.triangleCount;
+    settings.rectangleCount = scene.rectangleCount;
+    settings.shaderCount = scene.shaderCount;
+    settings.uniformUpdates = scene.uniformUpdates;
+    settings.materialCount = scene.materialCount;
+    settings.sceneScale = scene.sceneScale;
+    settings.frustumCulling = scene.frustumCulling;
+    settings.hierarchicalCulling = scene.hierarchicalCulling;
+    settings.occluderCount = scene.occluderCount;
+    settings.occlusionCulling = scene.occlusionCulling;
+    settings.sphereSegments = scene.sphereSegments;
+    settings.lod = scene.lod;
+    settings.lodPixelError = scene.lodPixelError;
+}
+
+
+static std::vector<BenchWorkload> MakeWorkloads( const EngineSettings& base, int objects )
+{
+    std::vector<BenchWorkload> workloads;
+    BenchWorkload workload;
+
+    workload = { "triangles", base };
+    workload.settings.triangleCount = objects;
+    workloads.push_back( workload );
+
+    workload = { "rectangles", base };
+    workload.settings.rectangleCount = objects;
+    workloads.push_back( workload );
+
+    workload = { "shader-switches", base };
+    workload.settings.triangleCount = objects;
+    workload.settings.shaderCount = 16;
+    workloads.push_back( workload );
+
+    workload = { "uniform-updates", base };
+    workload.settings.triangleCount = objects;
+    workload.settings.uniformUpdates = true;
+    workloads.push_back( workload );
+
+    workload = { "uniform-buffers", base };
+    workload.settings.triangleCount = objects;
+    workload.settings.materialCount = 64;
+    workloads.push_back( workload );
+
+    workload = { "quads-instanced", base };
+    workload.settings.quadCount = objects * 10;
+    workloads.push_back( workload );
+
+    workload = { "quads-per-object", base };
+    workload.settings.quadCount = objects;
+    workload.settings.perObjectQuads = true;
+    workloads.push_back( workload );
+
+    // The instanced quads aiming for 4 ms a frame by lowering the resolution; where that
+    // does not make frames faster, as on software renderers, the scaler backs off again.
+    workload = { "quads-dynamic-resolution", base };
+    workload.settings.quadCount = objects * 10;
+    workload.settings.dynamicResolution = true;
+    workload.settings.targetGpuMs = 4.0f;
+    workloads.push_back( workload );
+
+    // A grid four screens wide with per-object transforms, so 15/16 of it is off screen.
+    workload = { "culled-grid", base };
+    workload.settings.triangleCount = objects * 16;
+    workload.settings.uniformUpdates = true;
+    workload.settings.sceneScale = 4.0f;
+    workloads.push_back( workload );
+
+    workload = { "culled-grid-linear", workload.settings };
+    workload.settings.hierarchicalCulling = false;
+    workloads.push_back( workload );
+
+    workload = { "unculled-grid", workload.settings };
+    workload.settings.frustumCulling = false;
+    workloads.push_back( workload );
+
+    // An on-screen grid with a 4x4 set of walls in front hiding a bit over half of it.
+    workload = { "occluded-grid", base };
+    workload.settings.triangleCount = objects * 4;
+    workload.settings.uniformUpdates = true;
+    workload.settings.occluderCount = 16;
+    workloads.push_back( workload );
+
+    workload = { "occluded-grid-off", workload.settings };
+    workload.settings.occlusionCulling = false;
+    workloads.push_back( workload );
+
+    // Vertex-bound: one large mesh uploaded as authored against the optimized upload.
+    workload = { "sphere-as-authored", base };
+    workload.settings.sphereSegments = 320;
+    workload.settings.lod = false;
+    workload.settings.optimizeMeshes = false;
+    workloads.push_back( workload );
+
+    workload = { "sphere-optimized", base };
+    workload.settings.sphereSegments = 320;
+    workload.settings.lod = false;
+    workloads.push_back( workload );
+
+    // A grid of spheres a few dozen pixels across, drawn at the level of detail their
+    // screen size calls for against always in full.
+    workload = { "lod-spheres", base };
+    workload.settings.triangleCount = objects;
+    workload.settings.uniformUpdates = true;
+    workload.settings.sphereSegments = 64;
+    workloads.push_back( workload );
+
+    workload = { "lod-spheres-off", workload.settings };
+    workload.settings.lod = false;
+    workloads.push_back( workload );
+
+    // CPU cost of handing the same static scene to GL per draw, as a client-side
+    // multi-draw and as a multi-draw indirect, at fixed sizes independent of --objects.
+    const char* submitNames[] = { "per-draw", "multi-draw", "indirect" };
+    for ( int count : { 1000, 10000, 100000 } )
+        for ( int mode = 0; mode < 3; mode++ )
+        {
+            workload = { std::string( "submit-" ) + submitNames[mode] + "-" + std::to_string( count / 1000 ) + "k", base };
+            workload.settings.triangleCount = count;
+            workload.settings.drawSubmission = mode;
+            workloads.push_back( workload );
+        }
+
+    return workloads;
+}
+
+
+struct CullResult
+{
+    std::string name;
+    int mode;
+    int threads;
+    int objects;
+    int visible;
+    double msPerCull;
+};
+
+
+struct JobResult
+{
+    std::string name;
+    int threads;
+    // Work items per run, and the jobs they took; a ParallelFor on one thread runs inline.
+    int items;
+    long long jobs;
+    double nsPerItem;
+    double stealsPerJob;
+};
+
+
+struct BvhResult
+{
+    std::string name;
+    int objects;
+    // Items handled per run: every object for whole-tree passes, else the updates or queries.
+    int operations;
+    double msPerRun;
+    int height;
+    float cost;
+};
+
+
+static bool IsSelected( const std::vector<std::string>& selected, const std::string& name )
+{
+    bool wanted = selected.empty();
+    for ( const std::string& prefix : selected )
+        wanted = wanted || name.compare( 0, prefix.size(), prefix ) == 0;
+    return wanted;
+}
+
+
+// A million random spheres in a volume eight times the clip cube, so about an eighth
+// survive, culled per mode on one thread and on every hardware thread.
+static std::vector<CullResult> RunCullBenchmarks( const std::vector<std::string>& selected, int repeats )
+{
+    std::vector<CullResult> results;
+    const int objects = 1000000;
+    BoundsStore bounds;
+    std::mt19937 random( 1 );
+    std::uniform_real_distribution<float> position( -2.0f, 2.0f );
+    std::uniform_real_distribution<float> size( 0.001f, 0.01f );
+    for ( int i = 0; i < objects; i++ )
+    {
+        float x = position( random );
+        float y = position( random );
+        float z = position( random );
+        bounds.Add( x, y, z, size( random ) );
+    }
+    Frustum frustum = Frustum::ClipCube();
+
+    int hardwareThreads = (int) std::max( std::thread::hardware_concurrency(), 1u );
+    std::vector<int> threadCounts = { 1 };
+    if ( hardwareThreads > 1 )
+        threadCounts.push_back( hardwareThreads );
+    const char* modeNames[] = { "scalar", "sse", "avx2" };
+    for ( int mode = FrustumCuller::MODE_SCALAR; mode <= FrustumCuller::MODE_AVX2; mode++ )
+        for ( int threads : threadCounts )
+        {
+            std::string name = std::string( "cull-" ) + modeNames[mode] + "-" + std::to_string( threads ) + "t";
+            if ( !IsSelected( selected, name ) )
+                continue;
+            if ( !FrustumCuller::IsModeAvailable( mode ) )
+            {
+                std::cout << "Skipping " << name << ", not supported on this CPU" << std::endl;
+                continue;
+            }
+            JobSystem jobs;
+            jobs.Init( threads );
+            FrustumCuller culler;
+            culler.Init( &jobs );
+            culler.mode = mode;
+            // One untimed pass to allocate the output and warm the caches.
+            culler.Cull( bounds, frustum );
+            culler.seconds = 0.0;
+            culler.culls = 0;
+            for ( int i = 0; i < repeats; i++ )
+                culler.Cull( bounds, frustum );
+            results.push_back( { name, mode, threads, objects, culler.GetVisibleCount(), culler.seconds * 1000.0 / culler.culls } );
+        }
+    return results;
+}
+
+
+// Scheduling overhead of the job system with empty or near-empty jobs, on one thread and
+// on every hardware thread: independent jobs started from the main thread, a ParallelFor
+// split down to single indices, and a chain where each job depends on the one before.
+static std::vector<JobResult> RunJobBenchmarks( const std::vector<std::string>& selected, int repeats )
+{
+    std::vector<JobResult> results;
+    const int jobCount = 100000;
+    const int chainLength = 1000;
+    int hardwareThreads = (int) std::max( std::thread::hardware_concurrency(), 1u );
+    std::vector<int> threadCounts = { 1 };
+    if ( hardwareThreads > 1 )
+        threadCounts.push_back( hardwareThreads );
+    std::vector<int> touched( jobCount );
+
+    for ( int threads : threadCounts )
+    {
+        JobSystem jobs;
+        jobs.Init( threads );
+        auto time = [&]( const std::string& name, int items, const std::function<void()>& run )
+        {
+            if ( !IsSelected( selected, name ) )
+                return;
+            run();
+            long long jobsBefore = jobs.GetJobCount();
+            long long stealsBefore = jobs.GetStealCount();
+            auto start = std::chrono::steady_clock::now();
+            for ( int i = 0; i < repeats; i++ )
+                run();
+            double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - start ).count();
+            long long jobsRun = jobs.GetJobCount() - jobsBefore;
+            double steals = (double) ( jobs.GetStealCount() - stealsBefore );
+            results.push_back( { name, threads, items, jobsRun / repeats, ns / ( (double) items * repeats ), jobsRun > 0 ? steals / jobsRun : 0.0 } );
+        };
+
+        std::string suffix = "-" + std::to_string( threads ) + "t";
+        time( "jobs-independent" + suffix, jobCount, [&]()
+        {
+            JobCounter counter;
+            for ( int i = 0; i < jobCount; i++ )
+                jobs.Run( [&touched, i]() { touched[i]++; }, counter );
+            jobs.Wait( counter );
+        } );
+        time( "jobs-parallel-for" + suffix, jobCount, [&]()
+        {
+            jobs.ParallelFor( 0, jobCount, 1, [&touched]( int begin, int end )
+            {
+                for ( int i = begin; i < end; i++ )
+                    touched[i]++;
+            } );
+        } );
+        time( "jobs-chain" + suffix, chainLength, [&]()
+        {
+            std::unique_ptr<JobCounter[]> counters( new JobCounter[chainLength] );
+            for ( int i = 0; i < chainLength; i++ )
+                jobs.Run( [&touched, i]() { touched[i]++; }, counters[i], i > 0 ? &counters[i - 1] : nullptr );
+            jobs.Wait( counters[chainLength - 1] );
+        } );
+    }
+    return results;
+}
+
+
+static std::vector<Aabb> MakeRandomBoxes( int count, float extent, unsigned int seed )
+{
+    std::mt19937 random( seed );
+    std::uniform_real_distribution<float> position( -extent, extent );
+    std::uniform_real_distribution<float> size( 0.001f, 0.01f );
+    std::vector<Aabb> boxes( count );
+    for ( Aabb& box : boxes )
+    {
+        float x = position( random );
+        float y = position( random );
+        float z = position( random );
+        box = Aabb::FromSphere( x, y, z, size( random ) );
+    }
+    return boxes;
+}
+
+
+// Build, update and query timings for a Bvh over 100k objects spread like the cull-* set.
+static std::vector<BvhResult> RunBvhBenchmarks( const std::vector<std::string>& selected, int repeats )
+{
+    std::vector<BvhResult> results;
+    const int objects = 100000;
+    const int queries = 10000;
+    std::vector<Aabb> boxes = MakeRandomBoxes( objects, 2.0f, 1 );
+    std::vector<Aabb> moved = MakeRandomBoxes( objects, 2.0f, 2 );
+    std::vector<Aabb> queryBoxes = MakeRandomBoxes( queries, 2.0f, 3 );
+    std::vector<int> leaves( objects );
+    std::vector<int> found;
+    Bvh tree;
+    tree.Build( boxes.data(), objects, leaves.data() );
+
+    auto time = [&]( const std::string& name, int operations, const std::function<void( int )>& run )
+    {
+        if ( !IsSelected( selected, name ) )
+            return;
+        run( -1 );
+        auto start = std::chrono::steady_clock::now();
+        for ( int i = 0; i < repeats; i++ )
+            run( i );
+        double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count() / repeats;
+        results.push_back( { name, objects, operations, ms, tree.GetHeight(), tree.GetCost() } );
+    };
+
+    time( "bvh-build", objects, [&]( int ) { tree.Build( boxes.data(), objects, leaves.data() ); } );
+    time( "bvh-insert", objects, [&]( int )
+    {
+        tree.Clear();
+        for ( int i = 0; i < objects; i++ )
+            leaves[i] = tree.Insert( boxes[i], i );
+    } );
+    // Every object jumps somewhere else: refit keeps the shape, move reinserts with rotations.
+    time( "bvh-refit", objects, [&]( int run )
+    {
+        const std::vector<Aabb>& target = run % 2 == 0 ? moved : boxes;
+        for ( int i = 0; i < objects; i++ )
+            tree.SetLeafBounds( leaves[i], target[i] );
+        tree.Refit();
+    } );
+    tree.Build( boxes.data(), objects, leaves.data() );
+    time( "bvh-move", objects / 10, [&]( int run )
+    {
+        const std::vector<Aabb>& target = run % 2 == 0 ? moved : boxes;
+        for ( int i = 0; i < objects / 10; i++ )
+            tree.Move( leaves[i], target[i] );
+    } );
+    tree.Build( boxes.data(), objects, leaves.data() );
+
+    Frustum frustum = Frustum::ClipCube();
+    time( "bvh-frustum", objects, [&]( int )
+    {
+        found.clear();
+        tree.QueryFrustum( frustum, found );
+    } );
+    time( "bvh-aabb", queries, [&]( int )
+    {
+        for ( const Aabb& box : queryBoxes )
+        {
+            found.clear();
+            tree.QueryAabb( box.Expanded( 0.05f ), found );
+        }
+    } );
+    time( "bvh-sphere", queries, [&]( int )
+    {
+        for ( const Aabb& box : queryBoxes )
+        {
+            found.clear();
+            tree.QuerySphere( box.min[0], box.min[1], box.min[2], 0.05f, found );
+        }
+    } );
+    time( "bvh-ray", queries, [&]( int )
+    {
+        for ( int i = 0; i < queries; i++ )
+        {
+            const Aabb& box = queryBoxes[i];
+            const Aabb& toward = queryBoxes[( i + 1 ) % queries];
+            float origin[3] = { box.min[0], box.min[1], box.min[2] };
+            float direction[3] = { toward.min[0] - origin[0], toward.min[1] - origin[1], toward.min[2] - origin[2] };
+            tree.RayCast( origin, direction, 1.0f );
+        }
+    } );
+    return results;
+}
+
+
+static std::string JsonString( const std::string& text )
+{
+    std::string escaped = "\"";
+    for ( char c : text )
+    {
+        if ( c == '"' || c == '\\' )
+            escaped += '\\';
+        if ( (unsigned char) c >= 0x20 )
+            escaped += c;
+    }
+    return escaped + "\"";
+}
+
+
+static double GetScopeAverage( const RunStats& stats, const std::string& path )
+{
+    for ( const ProfileStats& scope : stats.scopes )
+        if ( !scope.gpu && scope.path == path )
+            return scope.avgMs;
+    return 0.0;
+}
+
+
+// With the render thread, submission is timed under that thread's own root scope.
+static double GetSubmitAverage( const EngineSettings& settings, const RunStats& stats )
+{
+    return GetScopeAverage( stats, settings.renderThread ? "RenderFrame/Render/Submit" : "Frame/Render/Submit" );
+}
+
+
+static void WriteWorkload( std::ostream& out, const BenchWorkload& workload, const RunStats& stats )
+{
+    const EngineSettings& settings = workload.settings;
+    double frames = stats.frames > 0 ? stats.frames : 1;
+
+    out << "    {\n";
+    out << "      \"name\": " << JsonString( workload.name ) << ",\n";
+    out << "      \"triangles\": " << settings.triangleCount << ",\n";
+    out << "      \"rectangles\": " << settings.rectangleCount << ",\n";
+    out << "      \"shaders\": " << settings.shaderCount << ",\n";
+    out << "      \"uniformUpdates\": " << ( settings.uniformUpdates ? "true" : "false" ) << ",\n";
+    out << "      \"materials\": " << settings.materialCount << ",\n";
+    out << "      \"quads\": " << settings.quadCount << ",\n";
+    out << "      \"perObjectQuads\": " << ( settings.perObjectQuads ? "true" : "false" ) << ",\n";
+    out << "      \"drawSubmission\": " << settings.drawSubmission << ",\n";
+    out << "      \"sceneScale\": " << settings.sceneScale << ",\n";
+    out << "      \"frustumCulling\": " << ( settings.frustumCulling ? "true" : "false" ) << ",\n";
+    out << "      \"visibleObjectsPerFrame\": " << stats.objectsVisible / frames << ",\n";
+    out << "      \"cullMsPerFrame\": " << stats.cullSeconds * 1000.0 / frames << ",\n";
+    out << "      \"occluders\": " << settings.occluderCount << ",\n";
+    out << "      \"occlusionCulling\": " << ( settings.occlusionCulling ? "true" : "false" ) << ",\n";
+    out << "      \"occludedObjectsPerFrame\": " << stats.objectsOccluded / frames << ",\n";
+    out << "      \"occlusionMsPerFrame\": " << stats.occlusionSeconds * 1000.0 / frames << ",\n";
+    out << "      \"sphereSegments\": " << settings.sphereSegments << ",\n";
+    out << "      \"lod\": " << ( settings.lod ? "true" : "false" ) << ",\n";
+    out << "      \"lodPixelError\": " << settings.lodPixelError << ",\n";
+    out << "      \"meshTrianglesPerFrame\": " << stats.trianglesSubmitted / frames << ",\n";
+    out << "      \"optimizeMeshes\": " << ( settings.optimizeMeshes ? "true" : "false" ) << ",\n";
+    out << "      \"largestMeshTriangles\": " << stats.largestMeshTriangles << ",\n";
+    out << "      \"acmrBefore\": " << stats.meshCacheBefore.acmr << ",\n";
+    out << "      \"acmrAfter\": " << stats.meshCacheAfter.acmr << ",\n";
+    out << "      \"atvrBefore\": " << stats.meshCacheBefore.atvr << ",\n";
+    out << "      \"atvrAfter\": " << stats.meshCacheAfter.atvr << ",\n";
+    out << "      \"frames\": " << stats.frames << ",\n";
+    out << "      \"seconds\": " << stats.seconds << ",\n";
+    out << "      \"fps\": " << stats.frames / stats.seconds << ",\n";
+    out << "      \"msPerFrame\": " << stats.seconds * 1000.0 / frames << ",\n";
+    out << "      \"cpuRenderMsPerFrame\": " << stats.renderCpuSeconds * 1000.0 / frames << ",\n";
+    out << "      \"cpuSubmitMsPerFrame\": " << GetSubmitAverage( settings, stats ) << ",\n";
+    out << "      \"simulationHz\": " << settings.simulationHz << ",\n";
+    out << "      \"simulationStepsPerFrame\": " << stats.simulationSteps / frames << ",\n";
+    out << "      \"limiterMsPerFrame\": " << stats.limiterSeconds * 1000.0 / frames << ",\n";
+    out << "      \"gpuWaitMsPerFrame\": " << stats.gpuWaitSeconds * 1000.0 / frames << ",\n";
+    out << "      \"dynamicResolution\": " << ( settings.dynamicResolution ? "true" : "false" ) << ",\n";
+    out << "      \"renderScale\": " << stats.renderScale << ",\n";
+    out << "      \"renderScaleChanges\": " << stats.renderScaleChanges << ",\n";
+    out << "      \"renderScaleShrinksUndone\": " << stats.renderScaleShrinksUndone << ",\n";
+    out << "      \"gpuFrameMs\": " << stats.gpuFrameMs << ",\n";
+    out << "      \"cpuFrameMs\": " << stats.cpuFrameMs << ",\n";
+    out << "      \"cpuTimedFrames\": " << stats.cpuTimedFrames << ",\n";
+    out << "      \"packetWaitMsPerFrame\": " << stats.packetWaitSeconds * 1000.0 / frames << ",\n";
+    out << "      \"renderIdleMsPerFrame\": " << stats.renderIdleSeconds * 1000.0 / frames << ",\n";
+    out << "      \"drawCallsPerFrame\": " << stats.drawCalls / frames << ",\n";
+    out << "      \"commandsPerFrame\": " << stats.commandsDrawn / frames << ",\n";
+    out << "      \"programBindsPerFrame\": " << stats.programBinds / frames << ",\n";
+    out << "      \"vaoBindsPerFrame\": " << stats.vaoBinds / frames << ",\n";
+    out << "      \"uniformUpdatesPerFrame\": " << stats.uniformUpdates / frames << ",\n";
+    out << "      \"materialBindsPerFrame\": " << stats.materialBinds / frames << ",\n";
+    out << "      \"glStateCallsIssuedPerFrame\": " << stats.glStateCalls.issued / frames << ",\n";
+    out << "      \"glStateCallsFilteredPerFrame\": " << stats.glStateCalls.filtered / frames << ",\n";
+    out << "      \"scopes\": [";
+    for ( size_t i = 0; i < stats.scopes.size(); i++ )
+    {
+        const ProfileStats& scope = stats.scopes[i];
+        out << ( i == 0 ? "\n" : ",\n" );
+        out << "        { \"path\": " << JsonString( scope.path ) << ", \"gpu\": " << ( scope.gpu ? "true" : "false" )
+            << ", \"count\": " << scope.count << ", \"minMs\": " << scope.minMs << ", \"avgMs\": " << scope.avgMs
+            << ", \"p99Ms\": " << scope.p99Ms << ", \"maxMs\": " << scope.maxMs << " }";
+    }
+    out << "\n      ]\n";
+    out << "    }";
+}
+
+
+int main( int argc, char* argv[] )
+{
+    EngineSettings base;
+    base.headless = true;
+    base.maxFrames = 500;
+    base.vsync = FramePacer::VSYNC_OFF;
+    // Every workload draws every pixel, so frame times compare across runs and machines.
+    base.dynamicResolution = false;
+    base.profile = true;
+
+    EngineSettings custom;
+    bool useCustom = false;
+    int objects = 1000;
+    std::vector<std::string> selected;
+    std::string outputFile = "bench_results.json";
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--windowed" ) == 0 )
+            base.headless = false;
+        else if ( strcmp( argv[i], "--no-render-thread" ) == 0 )
+            base.renderThread = false;
+        else if ( strcmp( argv[i], "--frames-in-flight" ) == 0 && i + 1 < argc )
+            base.maxFramesInFlight = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--frames" ) == 0 && i + 1 < argc )
+            base.maxFrames = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--width" ) == 0 && i + 1 < argc )
+            base.width = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--height" ) == 0 && i + 1 < argc )
+            base.height = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--objects" ) == 0 && i + 1 < argc )
+            objects = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--workload" ) == 0 && i + 1 < argc )
+            selected.push_back( argv[++i] );
+        else if ( strcmp( argv[i], "--output" ) == 0 && i + 1 < argc )
+            outputFile = argv[++i];
+        else if ( strcmp( argv[i], "--triangles" ) == 0 && i + 1 < argc )
+        {
+            custom.triangleCount = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--rectangles" ) == 0 && i + 1 < argc )
+        {
+            custom.rectangleCount = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--shaders" ) == 0 && i + 1 < argc )
+        {
+            custom.shaderCount = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--materials" ) == 0 && i + 1 < argc )
+        {
+            custom.materialCount = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--uniform-updates" ) == 0 )
+        {
+            custom.uniformUpdates = true;
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--scene-scale" ) == 0 && i + 1 < argc )
+        {
+            custom.sceneScale = (float) atof( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--no-culling" ) == 0 )
+        {
+            custom.frustumCulling = false;
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--linear-culling" ) == 0 )
+        {
+            custom.hierarchicalCulling = false;
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--occluders" ) == 0 && i + 1 < argc )
+        {
+            custom.occluderCount = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--no-occlusion" ) == 0 )
+        {
+            custom.occlusionCulling = false;
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--sphere" ) == 0 && i + 1 < argc )
+        {
+            custom.sphereSegments = atoi( argv[++i] );
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--no-lod" ) == 0 )
+        {
+            custom.lod = false;
+            useCustom = true;
+        }
+        else if ( strcmp( argv[i], "--lod-error" ) == 0 && i + 1 < argc )
+        {
+            custom.lodPixelError = (float) atof( argv[++i] );
+            useCustom = true;
+        }
+        else
+            std::cout << "Ignoring unknown argument: " << argv[i] << std::endl;
+    }
+    if ( base.maxFrames <= 0 )
+    {
+        std::cout << "The benchmark needs a positive frame count" << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchWorkload> workloads;
+    if ( useCustom )
+    {
+        BenchWorkload workload = { "custom", base };
+        CopySceneSettings( custom, workload.settings );
+        workloads.push_back( workload );
+    }
+    else
+    {
+        for ( const BenchWorkload& workload : MakeWorkloads( base, objects ) )
+            if ( IsSelected( selected, workload.name ) )
+                workloads.push_back( workload );
+    }
+    std::vector<CullResult> cullResults;
+    std::vector<BvhResult> bvhResults;
+    std::vector<JobResult> jobResults;
+    if ( !useCustom )
+    {
+        cullResults = RunCullBenchmarks( selected, 100 );
+        bvhResults = RunBvhBenchmarks( selected, 5 );
+        jobResults = RunJobBenchmarks( selected, 20 );
+    }
+    if ( workloads.empty() && cullResults.empty() && bvhResults.empty() && jobResults.empty() )
+    {
+        std::cout << "No workload matched; the built-in ones are:";
+        for ( const BenchWorkload& workload : MakeWorkloads( base, objects ) )
+            std::cout << " " << workload.name;
+        std::cout << " cull-* bvh-* jobs-*" << std::endl;
+        return 1;
+    }
+
+    std::vector<RunStats> results;
+    for ( const BenchWorkload& workload : workloads )
+    {
+        std::cout << "== " << workload.name << " ==" << std::endl;
+        BananaEngine engine;
+        engine.Start( workload.settings );
+        results.push_back( engine.GetRunStats() );
+        if ( results.back().frames == 0 )
+        {
+            std::cout << "Workload " << workload.name << " rendered no frames" << std::endl;
+            return 1;
+        }
+    }
+
+    if ( !workloads.empty() )
+        std::cout << std::endl << "workload                      ms/frame   render ms   submit ms   draw calls" << std::endl;
+    for ( size_t i = 0; i < workloads.size(); i++ )
+    {
+        const RunStats& stats = results[i];
+        std::cout << std::left << std::setw( 28 ) << workloads[i].name << std::right << std::fixed << std::setprecision( 3 )
+                  << std::setw( 10 ) << stats.seconds * 1000.0 / stats.frames
+                  << std::setw( 12 ) << stats.renderCpuSeconds * 1000.0 / stats.frames
+                  << std::setw( 12 ) << GetSubmitAverage( workloads[i].settings, stats )
+                  << std::setw( 13 ) << std::setprecision( 0 ) << (double) stats.drawCalls / stats.frames << std::endl;
+    }
+    if ( !cullResults.empty() )
+    {
+        std::cout << std::endl << "culling                       ms/cull   objects/ms     visible" << std::endl;
+        for ( const CullResult& result : cullResults )
+            std::cout << std::left << std::setw( 28 ) << result.name << std::right << std::fixed << std::setprecision( 3 )
+                      << std::setw( 10 ) << result.msPerCull << std::setw( 13 ) << std::setprecision( 0 ) << result.objects / result.msPerCull
+                      << std::setw( 12 ) << result.visible << std::endl;
+    }
+    if ( !bvhResults.empty() )
+    {
+        std::cout << std::endl << "bvh                           ms/run     items/ms      height" << std::endl;
+        for ( const BvhResult& result : bvhResults )
+            std::cout << std::left << std::setw( 28 ) << result.name << std::right << std::fixed << std::setprecision( 3 )
+                      << std::setw( 10 ) << result.msPerRun << std::setw( 13 ) << std::setprecision( 0 ) << result.operations / result.msPerRun
+                      << std::setw( 12 ) << result.height << std::endl;
+    }
+    if ( !jobResults.empty() )
+    {
+        std::cout << std::endl << "jobs                          ns/item     jobs/run  steals/job" << std::endl;
+        for ( const JobResult& result : jobResults )
+            std::cout << std::left << std::setw( 28 ) << result.name << std::right << std::fixed << std::setprecision( 1 )
+                      << std::setw( 10 ) << result.nsPerItem << std::setw( 13 ) << result.jobs
+                      << std::setw( 12 ) << std::setprecision( 3 ) << result.stealsPerJob << std::endl;
+    }
+    std::cout << std::defaultfloat;
+
+    std::ofstream file( outputFile );
+    if ( !file.is_open() )
+    {
+        std::cerr << "Error opening the results file! " << outputFile << std::endl;
+        return 1;
+    }
+    file << "{\n";
+    file << "  \"renderer\": " << JsonString( results.empty() ? "" : results[0].renderer ) << ",\n";
+    file << "  \"mode\": " << ( base.headless ? "\"headless\"" : "\"windowed\"" ) << ",\n";
+    file << "  \"renderThread\": " << ( base.renderThread ? "true" : "false" ) << ",\n";
+    file << "  \"maxFramesInFlight\": " << base.maxFramesInFlight << ",\n";
+    file << "  \"width\": " << base.width << ",\n";
+    file << "  \"height\": " << base.height << ",\n";
+    file << "  \"workloads\": [\n";
+    for ( size_t i = 0; i < workloads.size(); i++ )
+    {
+        WriteWorkload( file, workloads[i], results[i] );
+        file << ( i + 1 < workloads.size() ? ",\n" : "\n" );
+    }
+    file << "  ],\n";
+    file << "  \"culling\": [";
+    for ( size_t i = 0; i < cullResults.size(); i++ )
+    {
+        const CullResult& result = cullResults[i];
+        file << ( i == 0 ? "\n" : ",\n" );
+        file << "    { \"name\": " << JsonString( result.name ) << ", \"mode\": " << JsonString( FrustumCuller::ModeName( result.mode ) )
+             << ", \"threads\": " << result.threads << ", \"objects\": " << result.objects << ", \"visible\": " << result.visible
+             << ", \"msPerCull\": " << result.msPerCull << ", \"objectsPerMs\": " << result.objects / result.msPerCull << " }";
+    }
+    file << "\n  ],\n";
+    file << "  \"bvh\": [";
+    for ( size_t i = 0; i < bvhResults.size(); i++ )
+    {
+        const BvhResult& result = bvhResults[i];
+        file << ( i == 0 ? "\n" : ",\n" );
+        file << "    { \"name\": " << JsonString( result.name ) << ", \"objects\": " << result.objects << ", \"operations\": " << result.operations
+             << ", \"msPerRun\": " << result.msPerRun << ", \"operationsPerMs\": " << result.operations / result.msPerRun
+             << ", \"height\": " << result.height << ", \"sahCost\": " << result.cost << " }";
+    }
+    file << "\n  ],\n";
+    file << "  \"jobs\": [";
+    for ( size_t i = 0; i < jobResults.size(); i++ )
+    {
+        const JobResult& result = jobResults[i];
+        file << ( i == 0 ? "\n" : ",\n" );
+        file << "    { \"name\": " << JsonString( result.name ) << ", \"threads\": " << result.threads << ", \"itemsPerRun\": " << result.items
+             << ", \"jobsPerRun\": " << result.jobs << ", \"nsPerItem\": " << result.nsPerItem << ", \"stealsPerJob\": " << result.stealsPerJob << " }";
+    }
+    file << "\n  ]\n";
+    file << "}\n";
+    std::cout << "Saved benchmark results to " << outputFile << std::endl;
+    return 0;
+}
@@ -0,0 +1,789 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "frustum_culler.h"
+
+
+struct Aabb
+{
+    float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+
+    static Aabb FromSphere( float x, float y, float z, float radius )
+    {
+        Aabb box;
+        const float center[3] = { x, y, z };
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            box.min[axis] = center[axis] - radius;
+            box.max[axis] = center[axis] + radius;
+        }
+        return box;
+    }
+
+
+    static Aabb Union( const Aabb& a, const Aabb& b )
+    {
+        Aabb box;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            box.min[axis] = std::min( a.min[axis], b.min[axis] );
+            box.max[axis] = std::max( a.max[axis], b.max[axis] );
+        }
+        return box;
+    }
+
+
+    Aabb Expanded( float amount ) const
+    {
+        Aabb box = *this;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            box.min[axis] -= amount;
+            box.max[axis] += amount;
+        }
+        return box;
+    }
+
+
+    float SurfaceArea() const
+    {
+        float dx = max[0] - min[0];
+        float dy = max[1] - min[1];
+        float dz = max[2] - min[2];
+        return 2.0f * ( dx * dy + dy * dz + dz * dx );
+    }
+
+
+    bool Contains( const Aabb& other ) const
+    {
+        for ( int axis = 0; axis < 3; axis++ )
+            if ( other.min[axis] < min[axis] || other.max[axis] > max[axis] )
+                return false;
+        return true;
+    }
+
+
+    bool Overlaps( const Aabb& other ) const
+    {
+        for ( int axis = 0; axis < 3; axis++ )
+            if ( other.min[axis] > max[axis] || other.max[axis] < min[axis] )
+                return false;
+        return true;
+    }
+
+
+    // Squared distance from a point to the box, 0 inside.
+    float DistanceSquared( const float point[3] ) const
+    {
+        float distance = 0.0f;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            float outside = std::max( std::max( min[axis] - point[axis], point[axis] - max[axis] ), 0.0f );
+            distance += outside * outside;
+        }
+        return distance;
+    }
+};
+
+
+// A dynamic bounding volume hierarchy with one object per leaf. Leaves are created with
+// Insert(), which picks the sibling with the least surface area cost, and keep their id
+// for as long as they live. Move() refits the path to the root and rotates nodes on the
+// way up to keep the tree tight; Rebuild() relinks all leaves top-down with a binned SAH
+// split, for when updates have degraded it or when many leaves were added at once.
+//
+// Queries append the object of every leaf whose box passes the test, in tree order. They
+// share scratch space, so run them from one thread at a time.
+class Bvh
+{
+public:
+    static const int NONE = -1;
+
+    // Leaves store their box grown by this much, so small moves leave the tree alone.
+    float margin = 0.0f;
+
+
+    int Insert( const Aabb& bounds, int object )
+    {
+        int leaf = AllocateNode();
+        nodes[leaf].box = bounds.Expanded( margin );
+        nodes[leaf].object = object;
+        InsertLeaf( leaf );
+        leafCount++;
+        return leaf;
+    }
+
+
+    void Remove( int leaf )
+    {
+        RemoveLeaf( leaf );
+        FreeNode( leaf );
+        leafCount--;
+    }
+
+
+    // Returns whether the tree changed; it does not while the new box fits the fat one.
+    bool Move( int leaf, const Aabb& bounds )
+    {
+        if ( nodes[leaf].box.Contains( bounds ) )
+            return false;
+        RemoveLeaf( leaf );
+        nodes[leaf].box = bounds.Expanded( margin );
+        InsertLeaf( leaf );
+        return true;
+    }
+
+
+    // Changes a leaf's box without fixing its ancestors; call Refit() after a batch of these.
+    void SetLeafBounds( int leaf, const Aabb& bounds )
+    {
+        nodes[leaf].box = bounds.Expanded( margin );
+    }
+
+
+    // Recomputes every internal box bottom-up, keeping the tree's shape.
+    void Refit()
+    {
+        if ( root == NONE )
+            return;
+        std::vector<int>& order = scratch;
+        order.clear();
+        order.push_back( root );
+        for ( size_t i = 0; i < order.size(); i++ )
+        {
+            const Node& node = nodes[order[i]];
+            if ( !node.IsLeaf() )
+            {
+                order.push_back( node.left );
+                order.push_back( node.right );
+            }
+        }
+        // Parents come before their children in order, so walking it backwards refits children first.
+        for ( size_t i = order.size(); i-- > 0; )
+        {
+            Node& node = nodes[order[i]];
+            if ( !node.IsLeaf() )
+                node.box = Aabb::Union( nodes[node.left].box, nodes[node.right].box );
+        }
+    }
+
+
+    // Clears the tree and builds it over objects 0 .. count - 1. leaves, when given,
+    // receives each object's leaf id.
+    void Build( const Aabb* bounds, int count, int* leaves = nullptr )
+    {
+        Clear();
+        for ( int i = 0; i < count; i++ )
+        {
+            int leaf = AllocateNode();
+            nodes[leaf].box = bounds[i].Expanded( margin );
+            nodes[leaf].object = i;
+            if ( leaves )
+                leaves[i] = leaf;
+        }
+        leafCount = count;
+        Rebuild();
+    }
+
+
+    // Relinks the existing leaves with a binned SAH build. Leaf ids stay valid.
+    void Rebuild()
+    {
+        std::vector<int> leaves;
+        leaves.reserve( leafCount );
+        for ( size_t i = 0; i < nodes.size(); i++ )
+            if ( nodes[i].height == 0 )
+                leaves.push_back( (int) i );
+            else if ( nodes[i].height > 0 )
+                FreeNode( (int) i );
+        root = leaves.empty() ? NONE : BuildRange( leaves.data(), (int) leaves.size() );
+        if ( root != NONE )
+            nodes[root].parent = NONE;
+        builtCost = GetCost();
+    }
+
+
+    // Rebuilds when the SAH cost has grown by factor since the last build.
+    bool RebuildIfDegraded( float factor = 1.5f )
+    {
+        if ( root == NONE || GetCost() <= builtCost * factor )
+            return false;
+        Rebuild();
+        return true;
+    }
+
+
+    void Clear()
+    {
+        nodes.clear();
+        freeNodes.clear();
+        root = NONE;
+        leafCount = 0;
+        builtCost = 0.0f;
+    }
+
+
+    // Hierarchical culling: a node outside any plane is skipped with its subtree, and planes a
+    // node is fully inside of are not tested again below it.
+    void QueryFrustum( const Frustum& frustum, std::vector<int>& objects ) const
+    {
+        if ( root == NONE )
+            return;
+        struct Entry
+        {
+            int node;
+            int planeMask;
+        };
+        std::vector<Entry> stack;
+        stack.push_back( { root, 0x3F } );
+        while ( !stack.empty() )
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[entry.node];
+            int mask = entry.planeMask;
+            bool outside = false;
+            for ( int plane = 0; plane < 6 && !outside; plane++ )
+            {
+                if ( !( mask & ( 1 << plane ) ) )
+                    continue;
+                const float* p = frustum.planes[plane];
+                float nearest = p[3];
+                float farthest = p[3];
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    float low = p[axis] * node.box.min[axis];
+                    float high = p[axis] * node.box.max[axis];
+                    nearest += std::min( low, high );
+                    farthest += std::max( low, high );
+                }
+                if ( farthest < 0.0f )
+                    outside = true;
+                else if ( nearest >= 0.0f )
+                    mask &= ~( 1 << plane );
+            }
+            if ( outside )
+                continue;
+            if ( node.IsLeaf() )
+                objects.push_back( node.object );
+            else if ( mask == 0 )
+                CollectSubtree( entry.node, objects );
+            else
+            {
+                stack.push_back( { node.right, mask } );
+                stack.push_back( { node.left, mask } );
+            }
+        }
+    }
+
+
+    void QueryAabb( const Aabb& bounds, std::vector<int>& objects ) const
+    {
+        Traverse( objects, [&bounds]( const Aabb& box ) { return box.Overlaps( bounds ); } );
+    }
+
+
+    void QuerySphere( float x, float y, float z, float radius, std::vector<int>& objects ) const
+    {
+        const float center[3] = { x, y, z };
+        float radiusSquared = radius * radius;
+        Traverse( objects, [&center, radiusSquared]( const Aabb& box ) { return box.DistanceSquared( center ) <= radiusSquared; } );
+    }
+
+
+    // Nearest leaf box along the ray within maxDistance; direction need not be normalized,
+    // distances are in units of its length. Returns the object, or NONE on a miss.
+    int RayCast( const float origin[3], const float direction[3], float maxDistance, float* hitDistance = nullptr ) const
+    {
+        if ( root == NONE )
+            return NONE;
+        float inverse[3];
+        for ( int axis = 0; axis < 3; axis++ )
+            inverse[axis] = 1.0f / direction[axis];
+
+        int hit = NONE;
+        float best = std::min( maxDistance, FLT_MAX );
+        std::vector<int>& stack = scratch;
+        stack.clear();
+        if ( RayBox( nodes[root].box, origin, inverse, best ) <= best )
+            stack.push_back( root );
+        while ( !stack.empty() )
+        {
+            int index = stack.back();
+            stack.pop_back();
+            const Node& node = nodes[index];
+            if ( node.IsLeaf() )
+            {
+                float distance = RayBox( node.box, origin, inverse, best );
+                if ( distance <= best )
+                {
+                    best = distance;
+                    hit = node.object;
+                }
+                continue;
+            }
+            // Visit the nearer child first so its hits can prune the farther one.
+            float leftDistance = RayBox( nodes[node.left].box, origin, inverse, best );
+            float rightDistance = RayBox( nodes[node.right].box, origin, inverse, best );
+            int nearChild = leftDistance <= rightDistance ? node.left : node.right;
+            int farChild = nearChild == node.left ? node.right : node.left;
+            if ( std::max( leftDistance, rightDistance ) <= best )
+                stack.push_back( farChild );
+            if ( std::min( leftDistance, rightDistance ) <= best )
+                stack.push_back( nearChild );
+        }
+        if ( hit != NONE && hitDistance )
+            *hitDistance = best;
+        return hit;
+    }
+
+
+    int GetObject( int leaf ) const
+    {
+        return nodes[leaf].object;
+    }
+
+
+    const Aabb& GetBounds( int leaf ) const
+    {
+        return nodes[leaf].box;
+    }
+
+
+    int GetLeafCount() const
+    {
+        return leafCount;
+    }
+
+
+    int GetHeight() const
+    {
+        return root == NONE ? 0 : nodes[root].height;
+    }
+
+
+    // Expected cost of a random query, the summed area of the internal nodes over the root's.
+    float GetCost() const
+    {
+        if ( root == NONE || nodes[root].IsLeaf() )
+            return 0.0f;
+        float area = 0.0f;
+        for ( const Node& node : nodes )
+            if ( node.height > 0 )
+                area += node.box.SurfaceArea();
+        float rootArea = nodes[root].box.SurfaceArea();
+        return rootArea > 0.0f ? area / rootArea : 0.0f;
+    }
+
+
+private:
+    struct Node
+    {
+        Aabb box;
+        int parent = NONE;
+        int left = NONE;
+        int right = NONE;
+        int object = NONE;
+        // 0 for leaves, -1 for nodes on the free list.
+        int height = 0;
+
+
+        bool IsLeaf() const
+        {
+            return height == 0;
+        }
+    };
+
+    static const int BINS = 16;
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root = NONE;
+    int leafCount = 0;
+    float builtCost = 0.0f;
+    mutable std::vector<int> scratch;
+
+
+    int AllocateNode()
+    {
+        if ( freeNodes.empty() )
+        {
+            nodes.emplace_back();
+            return (int) nodes.size() - 1;
+        }
+        int index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = Node();
+        return index;
+    }
+
+
+    void FreeNode( int index )
+    {
+        nodes[index].height = -1;
+        freeNodes.push_back( index );
+    }
+
+
+    // Best-first branch and bound over the tree for the sibling that adds the least area to
+    // it: the new parent's area plus the growth of every ancestor (Bittner et al.).
+    int FindBestSibling( const Aabb& box ) const
+    {
+        struct Candidate
+        {
+            int node;
+            float inheritedCost;
+        };
+        float leafArea = box.SurfaceArea();
+        int best = root;
+        float bestCost = Aabb::Union( nodes[root].box, box ).SurfaceArea();
+        // A min-heap on inherited cost, the part of the cost every node below already pays.
+        auto cheaper = []( const Candidate& a, const Candidate& b ) { return a.inheritedCost > b.inheritedCost; };
+        std::vector<Candidate> heap;
+        heap.push_back( { root, 0.0f } );
+        while ( !heap.empty() )
+        {
+            std::pop_heap( heap.begin(), heap.end(), cheaper );
+            Candidate candidate = heap.back();
+            heap.pop_back();
+            if ( leafArea + candidate.inheritedCost >= bestCost )
+                break;
+            const Node& node = nodes[candidate.node];
+            float unionArea = Aabb::Union( node.box, box ).SurfaceArea();
+            float cost = unionArea + candidate.inheritedCost;
+            if ( cost < bestCost )
+            {
+                bestCost = cost;
+                best = candidate.node;
+            }
+            if ( node.IsLeaf() )
+                continue;
+            // Anything below pays at least the leaf's own area on top of what is inherited here.
+            float inherited = candidate.inheritedCost + unionArea - node.box.SurfaceArea();
+            if ( leafArea + inherited < bestCost )
+            {
+                heap.push_back( { node.left, inherited } );
+                std::push_heap( heap.begin(), heap.end(), cheaper );
+                heap.push_back( { node.right, inherited } );
+                std::push_heap( heap.begin(), heap.end(), cheaper );
+            }
+        }
+        return best;
+    }
+
+
+    void InsertLeaf( int leaf )
+    {
+        if ( root == NONE )
+        {
+            root = leaf;
+            nodes[leaf].parent = NONE;
+            return;
+        }
+        int sibling = FindBestSibling( nodes[leaf].box );
+        int oldParent = nodes[sibling].parent;
+        int parent = AllocateNode();
+        nodes[parent].parent = oldParent;
+        nodes[parent].left = sibling;
+        nodes[parent].right = leaf;
+        nodes[parent].box = Aabb::Union( nodes[sibling].box, nodes[leaf].box );
+        nodes[parent].height = nodes[sibling].height + 1;
+        nodes[sibling].parent = parent;
+        nodes[leaf].parent = parent;
+        if ( oldParent == NONE )
+            root = parent;
+        else if ( nodes[oldParent].left == sibling )
+            nodes[oldParent].left = parent;
+        else
+            nodes[oldParent].right = parent;
+        RefitPath( oldParent );
+    }
+
+
+    void RemoveLeaf( int leaf )
+    {
+        if ( leaf == root )
+        {
+            root = NONE;
+            return;
+        }
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+        nodes[sibling].parent = grandParent;
+        if ( grandParent == NONE )
+            root = sibling;
+        else if ( nodes[grandParent].left == parent )
+            nodes[grandParent].left = sibling;
+        else
+            nodes[grandParent].right = sibling;
+        FreeNode( parent );
+        nodes[leaf].parent = NONE;
+        RefitPath( grandParent );
+    }
+
+
+    // Walks up from index, rotating each node and then refitting it.
+    void RefitPath( int index )
+    {
+        while ( index != NONE )
+        {
+            Rotate( index );
+            Node& node = nodes[index];
+            node.box = Aabb::Union( nodes[node.left].box, nodes[node.right].box );
+            node.height = 1 + std::max( nodes[node.left].height, nodes[node.right].height );
+            index = node.parent;
+        }
+    }
+
+
+    // Tree rotation (Kopta et al. 2012): swap a child of A with a grandchild on the other
+    // side when that shrinks the box of the child that gets rebuilt. Children are final.
+    void Rotate( int a )
+    {
+        int b = nodes[a].left;
+        int c = nodes[a].right;
+        float bestGain = 0.0f;
+        int swapChild = NONE;
+        int swapGrandChild = NONE;
+
+        // b with one of c's children: c's box becomes the other child plus b.
+        if ( !nodes[c].IsLeaf() )
+        {
+            float area = nodes[c].box.SurfaceArea();
+            int f = nodes[c].left;
+            int g = nodes[c].right;
+            float gainF = area - Aabb::Union( nodes[b].box, nodes[g].box ).SurfaceArea();
+            float gainG = area - Aabb::Union( nodes[b].box, nodes[f].box ).SurfaceArea();
+            if ( gainF > bestGain )
+            {
+                bestGain = gainF;
+                swapChild = b;
+                swapGrandChild = f;
+            }
+            if ( gainG > bestGain )
+            {
+                bestGain = gainG;
+                swapChild = b;
+                swapGrandChild = g;
+            }
+        }
+        if ( !nodes[b].IsLeaf() )
+        {
+            float area = nodes[b].box.SurfaceArea();
+            int d = nodes[b].left;
+            int e = nodes[b].right;
+            float gainD = area - Aabb::Union( nodes[c].box, nodes[e].box ).SurfaceArea();
+            float gainE = area - Aabb::Union( nodes[c].box, nodes[d].box ).SurfaceArea();
+            if ( gainD > bestGain )
+            {
+                bestGain = gainD;
+                swapChild = c;
+                swapGrandChild = d;
+            }
+            if ( gainE > bestGain )
+            {
+                bestGain = gainE;
+                swapChild = c;
+                swapGrandChild = e;
+            }
+        }
+        if ( swapChild == NONE )
+            return;
+
+        int other = nodes[swapGrandChild].parent;
+        if ( nodes[a].left == swapChild )
+            nodes[a].left = swapGrandChild;
+        else
+            nodes[a].right = swapGrandChild;
+        if ( nodes[other].left == swapGrandChild )
+            nodes[other].left = swapChild;
+        else
+            nodes[other].right = swapChild;
+        nodes[swapGrandChild].parent = a;
+        nodes[swapChild].parent = other;
+
+        Node& changed = nodes[other];
+        changed.box = Aabb::Union( nodes[changed.left].box, nodes[changed.right].box );
+        changed.height = 1 + std::max( nodes[changed.left].height, nodes[changed.right].height );
+    }
+
+
+    // Top-down binned SAH over leaves[0 .. count), returning the subtree's root.
+    int BuildRange( int* leaves, int count )
+    {
+        if ( count == 1 )
+            return leaves[0];
+
+        Aabb centroids;
+        for ( int i = 0; i < count; i++ )
+        {
+            float center[3];
+            Centroid( leaves[i], center );
+            for ( int axis = 0; axis < 3; axis++ )
+            {
+                centroids.min[axis] = std::min( centroids.min[axis], center[axis] );
+                centroids.max[axis] = std::max( centroids.max[axis], center[axis] );
+            }
+        }
+        int axis = 0;
+        for ( int candidate = 1; candidate < 3; candidate++ )
+            if ( centroids.max[candidate] - centroids.min[candidate] > centroids.max[axis] - centroids.min[axis] )
+                axis = candidate;
+        float extent = centroids.max[axis] - centroids.min[axis];
+
+        int middle = count / 2;
+        if ( extent > 0.0f )
+        {
+            Aabb binBoxes[BINS];
+            int binCounts[BINS] = {};
+            float scale = BINS / extent;
+            for ( int i = 0; i < count; i++ )
+            {
+                int bin = BinOf( leaves[i], axis, centroids.min[axis], scale );
+                binCounts[bin]++;
+                binBoxes[bin] = Aabb::Union( binBoxes[bin], nodes[leaves[i]].box );
+            }
+
+            // Sweep from the right for the right-hand areas, then from the left for the cost.
+            float rightAreas[BINS];
+            Aabb accumulated;
+            for ( int bin = BINS - 1; bin > 0; bin-- )
+            {
+                accumulated = Aabb::Union( accumulated, binBoxes[bin] );
+                rightAreas[bin] = accumulated.SurfaceArea();
+            }
+            float bestCost = FLT_MAX;
+            int bestSplit = 0;
+            int leftCount = 0;
+            int rightCount = count;
+            accumulated = Aabb();
+            for ( int split = 1; split < BINS; split++ )
+            {
+                accumulated = Aabb::Union( accumulated, binBoxes[split - 1] );
+                leftCount += binCounts[split - 1];
+                rightCount -= binCounts[split - 1];
+                if ( leftCount == 0 || rightCount == 0 )
+                    continue;
+                float cost = accumulated.SurfaceArea() * leftCount + rightAreas[split] * rightCount;
+                if ( cost < bestCost )
+                {
+                    bestCost = cost;
+                    bestSplit = split;
+                }
+            }
+            if ( bestSplit > 0 )
+            {
+                float minimum = centroids.min[axis];
+                int* split = std::partition( leaves, leaves + count, [this, axis, minimum, scale, bestSplit]( int leaf )
+                                             { return BinOf( leaf, axis, minimum, scale ) < bestSplit; } );
+                middle = (int) ( split - leaves );
+            }
+        }
+        if ( middle == 0 || middle == count )
+            middle = count / 2;
+
+        int left = BuildRange( leaves, middle );
+        int right = BuildRange( leaves + middle, count - middle );
+        int parent = AllocateNode();
+        Node& node = nodes[parent];
+        node.left = left;
+        node.right = right;
+        node.box = Aabb::Union( nodes[left].box, nodes[right].box );
+        node.height = 1 + std::max( nodes[left].height, nodes[right].height );
+        nodes[left].parent = parent;
+        nodes[right].parent = parent;
+        return parent;
+    }
+
+
+    void Centroid( int leaf, float center[3] ) const
+    {
+        const Aabb& box = nodes[leaf].box;
+        for ( int axis = 0; axis < 3; axis++ )
+            center[axis] = 0.5f * ( box.min[axis] + box.max[axis] );
+    }
+
+
+    int BinOf( int leaf, int axis, float minimum, float scale ) const
+    {
+        const Aabb& box = nodes[leaf].box;
+        int bin = (int) ( ( 0.5f * ( box.min[axis] + box.max[axis] ) - minimum ) * scale );
+        return std::min( std::max( bin, 0 ), BINS - 1 );
+    }
+
+
+    void CollectSubtree( int index, std::vector<int>& objects ) const
+    {
+        std::vector<int>& stack = scratch;
+        stack.clear();
+        stack.push_back( index );
+        while ( !stack.empty() )
+        {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if ( node.IsLeaf() )
+                objects.push_back( node.object );
+            else
+            {
+                stack.push_back( node.right );
+                stack.push_back( node.left );
+            }
+        }
+    }
+
+
+    template <typename Test>
+    void Traverse( std::vector<int>& objects, const Test& test ) const
+    {
+        if ( root == NONE )
+            return;
+        std::vector<int>& stack = scratch;
+        stack.clear();
+        stack.push_back( root );
+        while ( !stack.empty() )
+        {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if ( !test( node.box ) )
+                continue;
+            if ( node.IsLeaf() )
+                objects.push_back( node.object );
+            else
+            {
+                stack.push_back( node.right );
+                stack.push_back( node.left );
+            }
+        }
+    }
+
+
+    // Entry distance of the ray into box, or infinity when it misses or enters beyond limit.
+    static float RayBox( const Aabb& box, const float origin[3], const float inverse[3], float limit )
+    {
+        float enter = 0.0f;
+        float exit = limit;
+        for ( int axis = 0; axis < 3; axis++ )
+        {
+            float t0 = ( box.min[axis] - origin[axis] ) * inverse[axis];
+            float t1 = ( box.max[axis] - origin[axis] ) * inverse[axis];
+            if ( t0 > t1 )
+                std::swap( t0, t1 );
+            // NaN from 0 * inf, a ray in a slab's plane, counts as inside that slab.
+            enter = t0 > enter ? t0 : enter;
+            exit = t1 < exit ? t1 : exit;
+            if ( enter > exit )
+                return std::numeric_limits<float>::infinity();
+        }
+        return enter;
+    }
+};
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef ENGINE_SETTINGS_H
+#define ENGINE_SETTINGS_H
+
+#include <string>
+
+
+struct EngineSettings
+{
+    int width = 800;
+    int height = 600;
+
+    // Render into an offscreen framebuffer through EGL instead of opening a GLFW window.
+    bool headless = false;
+    // Stop after this many frames; 0 runs until the window is closed. Headless runs need a limit.
+    int maxFrames = 0;
+    // Headless only: where to write the last frame as a PPM image, empty to skip.
+    std::string captureFile = "";
+
+    // Stress scene: draw this many animated quads instead of the single shape.
+    int quadCount = 0;
+    // Submit the stress quads one draw call each instead of through the instanced QuadBatch.
+    bool perObjectQuads = false;
+    // Stream dynamic data through a persistently mapped buffer when ARB_buffer_storage is
+    // available; false forces the plain 3.3 unsynchronized-map/orphaning path.
+    bool persistentMapping = true;
+    // Store static meshes with half-float positions and UNORM8 colors (12 bytes per vertex)
+    // instead of full floats (24 bytes).
+    bool compactVertices = true;
+    // How the render queue issues its draws, one of RenderQueue::SUBMIT_*: 0 one call per
+    // draw, 1 glMultiDrawElementsBaseVertex, 2 glMultiDrawElementsIndirect (falls back to 1).
+    int drawSubmission = 2;
+
+    // Benchmark scene: draw this many small triangles and rectangles through the render
+    // queue instead of the single shape. Ignored while quadCount is set.
+    int triangleCount = 0;
+    int rectangleCount = 0;
+    // Spread the benchmark objects over this many programs, forcing a switch per program.
+    int shaderCount = 1;
+    // Place every benchmark object with its own transform uniform, set before each draw.
+    // Without it all objects share one transform set when the programs finish loading.
+    bool uniformUpdates = false;
+    // Tint the benchmark objects with this many materials from the per-material uniform
+    // buffer, bound per material change instead of set per draw; 0 keeps vertex colors.
+    int materialCount = 0;
+    // Spread the benchmark grid over this many screen widths; with uniformUpdates the
+    // objects beyond the screen are frustum culled.
+    float sceneScale = 1.0f;
+    // Test the benchmark objects' bounding spheres against the view and draw only the survivors.
+    bool frustumCulling = true;
+    // Cull through a bounding volume hierarchy instead of testing every object with SIMD.
+    bool hierarchicalCulling = true;
+    // Draw this many square walls in front of the benchmark grid, spread over the screen.
+    int occluderCount = 0;
+    // Skip benchmark objects a CPU depth buffer of the walls shows to be fully behind them.
+    bool occlusionCulling = true;
+
+    // Mesh scene: draw one UV sphere with this many segments around and half as many rings,
+    // loaded with its triangles and vertices shuffled. In the benchmark scene the sphere
+    // takes the place of every triangle; other scenes ignore it.
+    int sphereSegments = 0;
+    // Reorder static meshes for the post-transform cache, overdraw and vertex fetch before
+    // upload; off uploads them exactly as authored.
+    bool optimizeMeshes = true;
+    // Load the meshes with this many throwaway meshes before each one, then remove those
+    // and defragment the pools before the first frame, which must draw the same as with 0.
+    int meshChurn = 0;
+    // Build a chain of simplified levels for meshes of 256 triangles or more when they
+    // load, and draw each object at the coarsest level whose error stays under
+    // lodPixelError pixels on screen.
+    bool lod = true;
+    float lodPixelError = 1.0f;
+
+    // Advance the simulation in fixed steps at this rate, whatever the frame rate; frames
+    // draw a blend of the last two steps.
+    double simulationHz = 60.0;
+    // Run at most this many steps per frame and drop the time beyond, so a stall cannot
+    // leave the simulation further behind every frame.
+    int maxSimulationSteps = 8;
+    // Off runs only the simulation, one step per loop iteration as fast as it goes, without
+    // recording or drawing anything; maxFrames then counts steps.
+    bool rendering = true;
+
+    // Hand the GL context to a render thread that draws each frame while the main thread
+    // records the next one; off does both on the main thread, one after the other.
+    bool renderThread = true;
+    // Threads in the job system that culling and other per-frame work is spread over,
+    // counting the main thread; 0 uses one per hardware thread.
+    int jobThreads = 0;
+
+    // Windowed only: how buffer swaps sync to the display refresh, one of FramePacer::VSYNC_*:
+    // 0 off, 1 on, 2 adaptive (on, but late frames swap at once; falls back to 1).
+    int vsync = 1;
+    // Hold the main loop to this many frames per second by sleeping, then spinning; 0 runs
+    // as fast as the swap allows.
+    double maxFps = 0.0;
+    // Let the GPU fall at most this many frames behind before the CPU waits on a fence,
+    // bounding input-to-photon latency when the GPU is the bottleneck; 0 leaves it to the driver.
+    int maxFramesInFlight = 2;
+
+    // Draw the scene offscreen at a fraction of the window size per axis, between
+    // minRenderScale and maxRenderScale, lowered and raised to hold the measured GPU frame
+    // time at targetGpuMs, then stretch it onto the window. Where GPU timestamps miss the
+    // work, as on software renderers, the CPU time of the frame's GL calls stands in.
+    // targetGpuMs 0 aims for the maxFps frame time, or 60 Hz without one.
+    bool dynamicResolution = true;
+    float minRenderScale = 0.5f;
+    float maxRenderScale = 1.0f;
+    float targetGpuMs = 0.0f;
+
+    // Time the main loop phases and print min/avg/p99 per scope when the run ends.
+    bool profile = false;
+    // Write a Chrome trace-event JSON of every profiled scope here; implies profile.
+    std::string traceFile = "";
+};
+
+#endif
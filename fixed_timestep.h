@@ -0,0 +1,69 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <algorithm>
+
+
+// Turns variable frame times into whole simulation steps of a fixed length. Real time goes
+// into an accumulator and comes out one step at a time; what is left, less than a step, is
+// how far rendering should blend from the previous state toward the current one. A frame
+// never runs more than maxSteps steps: after a stall the time beyond that is dropped, so a
+// slow simulation cannot fall further behind every frame.
+//
+//   timestep.Init( 60.0, 8 );
+//   int steps = timestep.Advance( frameSeconds );
+//   for ( int i = 0; i < steps; i++ )
+//       Step( timestep.stepSeconds );
+//   Draw( Lerp( previous, current, timestep.GetAlpha() ) );
+class FixedTimestep
+{
+public:
+    double stepSeconds = 1.0 / 60.0;
+    int maxSteps = 8;
+
+    // Totals since Init().
+    long long steps = 0;
+    long long framesClamped = 0;
+    double droppedSeconds = 0.0;
+
+
+    void Init( double hz, int maxSteps )
+    {
+        stepSeconds = 1.0 / ( hz > 0.0 ? hz : 60.0 );
+        this->maxSteps = maxSteps > 0 ? maxSteps : 1;
+        accumulator = 0.0;
+        steps = framesClamped = 0;
+        droppedSeconds = 0.0;
+    }
+
+
+    // Adds one frame's worth of real time and returns how many steps to run for it.
+    int Advance( double frameSeconds )
+    {
+        if ( frameSeconds > 0.0 )
+            accumulator += frameSeconds;
+        int count = (int) ( accumulator / stepSeconds );
+        accumulator = std::max( accumulator - count * stepSeconds, 0.0 );
+        if ( count > maxSteps )
+        {
+            droppedSeconds += ( count - maxSteps ) * stepSeconds;
+            framesClamped++;
+            count = maxSteps;
+        }
+        steps += count;
+        return count;
+    }
+
+
+    // Fraction of a step since the last one, from 0 to 1.
+    float GetAlpha() const
+    {
+        return (float) ( accumulator / stepSeconds );
+    }
+
+
+private:
+    double accumulator = 0.0;
+};
+
+#endif
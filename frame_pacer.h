@@ -0,0 +1,167 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+
+// Keeps frames evenly spaced and bounds how far the CPU runs ahead of the GPU.
+//
+// LimitFrameRate() holds the main loop to a target rate. It sleeps until just before the
+// deadline and spins the rest of the way, since sleeps wake late by an amount that varies
+// between systems; the margin it spins for follows how late its sleeps actually wake.
+//
+// WaitForFrameSlot() and EndFrame() go around each frame's GL work on the thread that owns
+// the context. EndFrame() fences the frame after its swap, and WaitForFrameSlot() waits for
+// the frame framesInFlight back to finish, so a GPU-bound run queues at most that many
+// frames and input stays at most that many frames old when it reaches the screen.
+class FramePacer
+{
+public:
+    // Swap interval choices for the vsync setting.
+    static const int VSYNC_OFF = 0;
+    static const int VSYNC_ON = 1;
+    // Sync to the refresh, but swap at once when a frame misses it (EXT_swap_control_tear).
+    static const int VSYNC_ADAPTIVE = 2;
+
+    static const int MAX_FRAMES_IN_FLIGHT = 8;
+
+    // Totals since Init(): frames the limiter held back and how it spent the time, and
+    // waits for the GPU to finish an older frame.
+    long long limitedFrames = 0;
+    double sleepSeconds = 0.0;
+    double spinSeconds = 0.0;
+    long long gpuWaits = 0;
+    double gpuWaitSeconds = 0.0;
+
+
+    // maxFps 0 leaves the rate alone; framesInFlight 0 leaves the queue depth to the driver.
+    void Init( double maxFps, int framesInFlight )
+    {
+        Unload();
+        frameDuration = Clock::duration::zero();
+        if ( maxFps > 0.0 )
+            frameDuration = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( 1.0 / maxFps ) );
+        this->framesInFlight = framesInFlight < MAX_FRAMES_IN_FLIGHT ? std::max( framesInFlight, 0 ) : MAX_FRAMES_IN_FLIGHT;
+        deadline = Clock::time_point();
+        sleepMargin = std::chrono::milliseconds( 1 );
+        frameIndex = 0;
+        limitedFrames = gpuWaits = 0;
+        sleepSeconds = spinSeconds = gpuWaitSeconds = 0.0;
+    }
+
+
+    // Needs the GL context, if any frame was fenced.
+    void Unload()
+    {
+        for ( GLsync& fence : fences )
+        {
+            if ( fence != NULL )
+                glDeleteSync( fence );
+            fence = NULL;
+        }
+    }
+
+
+    // Returns at the next frame's start time. A loop that fell more than a frame behind
+    // starts over from now rather than rushing frames out to catch up.
+    void LimitFrameRate()
+    {
+        if ( frameDuration == Clock::duration::zero() )
+            return;
+        Clock::time_point now = Clock::now();
+        if ( deadline == Clock::time_point() || now - deadline > frameDuration )
+            deadline = now;
+        else if ( now < deadline )
+        {
+            limitedFrames++;
+            Clock::time_point sleepUntil = deadline - sleepMargin;
+            if ( now < sleepUntil )
+            {
+                std::this_thread::sleep_until( sleepUntil );
+                Clock::time_point woke = Clock::now();
+                sleepSeconds += std::chrono::duration<double>( woke - now ).count();
+                AdjustSleepMargin( woke - sleepUntil );
+                now = woke;
+            }
+            Clock::time_point spinStart = now;
+            while ( ( now = Clock::now() ) < deadline )
+                std::this_thread::yield();
+            spinSeconds += std::chrono::duration<double>( now - spinStart ).count();
+        }
+        deadline += frameDuration;
+    }
+
+
+    // Waits until fewer than framesInFlight frames are queued on the GPU.
+    void WaitForFrameSlot()
+    {
+        if ( framesInFlight <= 0 )
+            return;
+        GLsync& fence = fences[frameIndex % framesInFlight];
+        if ( fence == NULL )
+            return;
+        if ( glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 ) == GL_TIMEOUT_EXPIRED )
+        {
+            gpuWaits++;
+            auto start = Clock::now();
+            while ( glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ) == GL_TIMEOUT_EXPIRED )
+            {
+            }
+            gpuWaitSeconds += std::chrono::duration<double>( Clock::now() - start ).count();
+        }
+        glDeleteSync( fence );
+        fence = NULL;
+    }
+
+
+    // After the swap: marks the end of this frame's GL work.
+    void EndFrame()
+    {
+        if ( framesInFlight <= 0 )
+            return;
+        fences[frameIndex % framesInFlight] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+        frameIndex++;
+    }
+
+
+    double GetMaxFps() const
+    {
+        return frameDuration == Clock::duration::zero() ? 0.0 : 1.0 / std::chrono::duration<double>( frameDuration ).count();
+    }
+
+
+    int GetFramesInFlight() const
+    {
+        return framesInFlight;
+    }
+
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::duration frameDuration = Clock::duration::zero();
+    Clock::time_point deadline;
+    // Spin this long before each deadline instead of sleeping through it.
+    Clock::duration sleepMargin = std::chrono::milliseconds( 1 );
+    int framesInFlight = 0;
+    long long frameIndex = 0;
+    GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+
+
+    // Jumps up to a late wake at once, and eases back down when sleeps come in early.
+    void AdjustSleepMargin( Clock::duration late )
+    {
+        const Clock::duration least = std::chrono::microseconds( 100 );
+        const Clock::duration most = std::chrono::milliseconds( 4 );
+        if ( late > sleepMargin )
+            sleepMargin = late;
+        else
+            sleepMargin = sleepMargin - ( sleepMargin - late ) / 16;
+        sleepMargin = std::min( std::max( sleepMargin, least ), most );
+    }
+};
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "job_system.h"
+
+// SSE2 is part of x86-64, AVX2 is checked for at run time.
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define BANANA_CULL_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define BANANA_TARGET_AVX2 __attribute__( ( target( "avx2" ) ) )
+#else
+#define BANANA_TARGET_AVX2
+#endif
+
+
+// Six planes a * x + b * y + c * z + d >= 0 that every visible point satisfies, with unit
+// normals so the distances can be compared to bounding sphere radii.
+struct Frustum
+{
+    float planes[6][4];
+
+
+    // Extracts the planes of a column-major view-projection matrix (Gribb & Hartmann).
+    // The identity matrix gives the clip cube, [-1, 1] on every axis.
+    static Frustum FromMatrix( const float* matrix )
+    {
+        Frustum frustum;
+        for ( int plane = 0; plane < 6; plane++ )
+        {
+            int row = plane / 2;
+            float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+            for ( int column = 0; column < 4; column++ )
+                frustum.planes[plane][column] = matrix[column * 4 + 3] + sign * matrix[column * 4 + row];
+
+            float* p = frustum.planes[plane];
+            float length = std::sqrt( p[0] * p[0] + p[1] * p[1] + p[2] * p[2] );
+            if ( length > 0.0f )
+                for ( int column = 0; column < 4; column++ )
+                    p[column] /= length;
+        }
+        return frustum;
+    }
+
+
+    static Frustum ClipCube()
+    {
+        const float identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+        return FromMatrix( identity );
+    }
+};
+
+
+// Bounding spheres kept as one array per component, so the culler can load 4 or 8
+// objects' worth of one component with a single instruction.
+class BoundsStore
+{
+public:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+
+    int Add( float centerX, float centerY, float centerZ, float sphereRadius )
+    {
+        x.push_back( centerX );
+        y.push_back( centerY );
+        z.push_back( centerZ );
+        radius.push_back( sphereRadius );
+        return (int) x.size() - 1;
+    }
+
+
+    void Set( int index, float centerX, float centerY, float centerZ, float sphereRadius )
+    {
+        x[index] = centerX;
+        y[index] = centerY;
+        z[index] = centerZ;
+        radius[index] = sphereRadius;
+    }
+
+
+    int Size() const
+    {
+        return (int) x.size();
+    }
+
+
+    void Clear()
+    {
+        x.clear();
+        y.clear();
+        z.clear();
+        radius.clear();
+    }
+};
+
+
+// Tests a BoundsStore against a frustum and lists the objects that survive. The store is
+// split into fixed-size chunks that are spread over the job system's threads; each chunk
+// writes its survivors in place and the lists are joined afterwards, so the output stays
+// in ascending index order.
+class FrustumCuller
+{
+public:
+    static const int MODE_SCALAR = 0;
+    static const int MODE_SSE = 1;
+    static const int MODE_AVX2 = 2;
+    // Objects per chunk; small enough to balance, large enough to amortize the hand-off.
+    static const int CHUNK_SIZE = 8192;
+
+    // Set by Init() to the best the CPU supports; lower it to compare.
+    int mode = MODE_SCALAR;
+
+    // Totals since Init().
+    long long culls = 0;
+    long long objectsTested = 0;
+    long long objectsVisible = 0;
+    double seconds = 0.0;
+
+
+    // Without a job system every chunk runs on the calling thread.
+    void Init( JobSystem* jobs = nullptr )
+    {
+        this->jobs = jobs;
+        mode = BestMode();
+        culls = objectsTested = objectsVisible = 0;
+        seconds = 0.0;
+    }
+
+
+    void Unload()
+    {
+        jobs = nullptr;
+        visible.reset();
+        capacity = 0;
+        visibleCount = 0;
+    }
+
+
+    int GetThreadCount() const
+    {
+        return jobs != nullptr ? jobs->GetThreadCount() : 1;
+    }
+
+
+    static bool IsModeAvailable( int mode )
+    {
+#ifdef BANANA_CULL_SIMD
+        if ( mode == MODE_AVX2 )
+        {
+#if defined( __GNUC__ ) || defined( __clang__ )
+            return __builtin_cpu_supports( "avx2" );
+#else
+            return false;
+#endif
+        }
+        return mode == MODE_SCALAR || mode == MODE_SSE;
+#else
+        return mode == MODE_SCALAR;
+#endif
+    }
+
+
+    static int BestMode()
+    {
+        if ( IsModeAvailable( MODE_AVX2 ) )
+            return MODE_AVX2;
+        return IsModeAvailable( MODE_SSE ) ? MODE_SSE : MODE_SCALAR;
+    }
+
+
+    static const char* ModeName( int mode )
+    {
+        if ( mode == MODE_AVX2 )
+            return "avx2";
+        return mode == MODE_SSE ? "sse" : "scalar";
+    }
+
+
+    // Indices of the objects intersecting the frustum, valid until the next Cull().
+    const uint32_t* Cull( const BoundsStore& bounds, const Frustum& frustum )
+    {
+        auto start = std::chrono::steady_clock::now();
+        int count = bounds.Size();
+        if ( count > capacity )
+        {
+            capacity = count;
+            visible.reset( new uint32_t[capacity] );
+        }
+
+        int chunkCount = ( count + CHUNK_SIZE - 1 ) / CHUNK_SIZE;
+        chunkVisible.assign( chunkCount, 0 );
+        int cullMode = IsModeAvailable( mode ) ? mode : MODE_SCALAR;
+        auto runChunks = [&]( int firstChunk, int lastChunk )
+        {
+            for ( int chunk = firstChunk; chunk < lastChunk; chunk++ )
+            {
+                int begin = chunk * CHUNK_SIZE;
+                int end = std::min( begin + CHUNK_SIZE, count );
+                chunkVisible[chunk] = CullRange( cullMode, bounds, frustum, begin, end, &visible[begin] );
+            }
+        };
+        if ( jobs != nullptr )
+            jobs->ParallelFor( 0, chunkCount, 1, runChunks );
+        else
+            runChunks( 0, chunkCount );
+
+        // Close the gaps between the chunks' survivor lists.
+        visibleCount = 0;
+        for ( int chunk = 0; chunk < chunkCount; chunk++ )
+        {
+            if ( visibleCount != chunk * CHUNK_SIZE )
+                memmove( &visible[visibleCount], &visible[chunk * CHUNK_SIZE], chunkVisible[chunk] * sizeof( uint32_t ) );
+            visibleCount += chunkVisible[chunk];
+        }
+
+        culls++;
+        objectsTested += count;
+        objectsVisible += visibleCount;
+        seconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        return visible.get();
+    }
+
+
+    int GetVisibleCount() const
+    {
+        return visibleCount;
+    }
+
+
+private:
+    JobSystem* jobs = nullptr;
+    std::unique_ptr<uint32_t[]> visible;
+    int capacity = 0;
+    int visibleCount = 0;
+    std::vector<int> chunkVisible;
+
+
+    static int CullRange( int mode, const BoundsStore& bounds, const Frustum& frustum, int begin, int end, uint32_t* out )
+    {
+#ifdef BANANA_CULL_SIMD
+        if ( mode == MODE_AVX2 )
+            return CullRangeAvx2( bounds, frustum, begin, end, out );
+        if ( mode == MODE_SSE )
+            return CullRangeSse( bounds, frustum, begin, end, out );
+#endif
+        return CullRangeScalar( bounds, frustum, begin, end, out );
+    }
+
+
+    static bool IsVisible( const BoundsStore& bounds, const Frustum& frustum, int i )
+    {
+        for ( const float* p : frustum.planes )
+            // Same association as the SIMD paths, so all modes agree on spheres touching a plane.
+            if ( ( p[0] * bounds.x[i] + p[1] * bounds.y[i] ) + ( p[2] * bounds.z[i] + p[3] ) < -bounds.radius[i] )
+                return false;
+        return true;
+    }
+
+
+    static int CullRangeScalar( const BoundsStore& bounds, const Frustum& frustum, int begin, int end, uint32_t* out )
+    {
+        int count = 0;
+        for ( int i = begin; i < end; i++ )
+            if ( IsVisible( bounds, frustum, i ) )
+                out[count++] = (uint32_t) i;
+        return count;
+    }
+
+
+#ifdef BANANA_CULL_SIMD
+    // Four spheres per iteration: one distance per plane for all four, one compare against
+    // -radius, and the AND of the six compares says which of them are visible.
+    static int CullRangeSse( const BoundsStore& bounds, const Frustum& frustum, int begin, int end, uint32_t* out )
+    {
+        __m128 planes[6][4];
+        for ( int p = 0; p < 6; p++ )
+            for ( int c = 0; c < 4; c++ )
+                planes[p][c] = _mm_set1_ps( frustum.planes[p][c] );
+        const __m128 signBit = _mm_set1_ps( -0.0f );
+
+        int count = 0;
+        int i = begin;
+        for ( ; i + 4 <= end; i += 4 )
+        {
+            __m128 x = _mm_loadu_ps( &bounds.x[i] );
+            __m128 y = _mm_loadu_ps( &bounds.y[i] );
+            __m128 z = _mm_loadu_ps( &bounds.z[i] );
+            __m128 negativeRadius = _mm_xor_ps( _mm_loadu_ps( &bounds.radius[i] ), signBit );
+            __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+            for ( int p = 0; p < 6; p++ )
+            {
+                __m128 distance = _mm_add_ps( _mm_add_ps( _mm_mul_ps( planes[p][0], x ), _mm_mul_ps( planes[p][1], y ) ),
+                                              _mm_add_ps( _mm_mul_ps( planes[p][2], z ), planes[p][3] ) );
+                inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, negativeRadius ) );
+            }
+            count += WriteSurvivors( _mm_movemask_ps( inside ), i, out + count );
+        }
+        return count + CullRangeScalar( bounds, frustum, i, end, out + count );
+    }
+
+
+    // The same as CullRangeSse, eight spheres at a time.
+    BANANA_TARGET_AVX2 static int CullRangeAvx2( const BoundsStore& bounds, const Frustum& frustum, int begin, int end, uint32_t* out )
+    {
+        __m256 planes[6][4];
+        for ( int p = 0; p < 6; p++ )
+            for ( int c = 0; c < 4; c++ )
+                planes[p][c] = _mm256_set1_ps( frustum.planes[p][c] );
+        const __m256 signBit = _mm256_set1_ps( -0.0f );
+
+        int count = 0;
+        int i = begin;
+        for ( ; i + 8 <= end; i += 8 )
+        {
+            __m256 x = _mm256_loadu_ps( &bounds.x[i] );
+            __m256 y = _mm256_loadu_ps( &bounds.y[i] );
+            __m256 z = _mm256_loadu_ps( &bounds.z[i] );
+            __m256 negativeRadius = _mm256_xor_ps( _mm256_loadu_ps( &bounds.radius[i] ), signBit );
+            __m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+            for ( int p = 0; p < 6; p++ )
+            {
+                __m256 distance = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( planes[p][0], x ), _mm256_mul_ps( planes[p][1], y ) ),
+                                                 _mm256_add_ps( _mm256_mul_ps( planes[p][2], z ), planes[p][3] ) );
+                inside = _mm256_and_ps( inside, _mm256_cmp_ps( distance, negativeRadius, _CMP_GE_OQ ) );
+            }
+            count += WriteSurvivors( _mm256_movemask_ps( inside ), i, out + count );
+        }
+        return count + CullRangeScalar( bounds, frustum, i, end, out + count );
+    }
+
+
+    static int WriteSurvivors( int mask, int base, uint32_t* out )
+    {
+        int count = 0;
+        while ( mask != 0 )
+        {
+            int lane = 0;
+            while ( !( mask & ( 1 << lane ) ) )
+                lane++;
+            out[count++] = (uint32_t) ( base + lane );
+            mask &= mask - 1;
+        }
+        return count;
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include "glad/glad.h"
+#include <cstddef>
+
+
+struct GLStateStats
+{
+    long long issued = 0;
+    long long filtered = 0;
+};
+
+
+// Shadow copy of the GL state the engine touches. Every bind and state toggle goes
+// through here so calls that would not change anything never reach the driver.
+// Call Invalidate() after creating a context or after code that bypasses the cache.
+class GLStateCache
+{
+public:
+    // Counts for the frame in progress, the last finished frame, and the whole run.
+    static inline GLStateStats frame;
+    static inline GLStateStats lastFrame;
+    static inline GLStateStats total;
+
+
+    static void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeTextureUnit = UNKNOWN;
+        for ( unsigned int& buffer : buffers )
+            buffer = UNKNOWN;
+        for ( IndexedBinding& binding : uniformBindings )
+            binding.id = UNKNOWN;
+        for ( unsigned int& framebuffer : framebuffers )
+            framebuffer = UNKNOWN;
+        for ( auto& unit : textures )
+            for ( unsigned int& texture : unit )
+                texture = UNKNOWN;
+        for ( int& capability : capabilities )
+            capability = -1;
+        blendSource = UNKNOWN;
+        blendDestination = UNKNOWN;
+        depthFunction = UNKNOWN;
+        cullFaceMode = UNKNOWN;
+        viewport[0] = viewport[1] = viewport[2] = viewport[3] = -1;
+        clearColorKnown = false;
+    }
+
+
+    static void EndFrame()
+    {
+        lastFrame = frame;
+        frame = GLStateStats();
+    }
+
+
+    static void ResetStats()
+    {
+        frame = GLStateStats();
+        lastFrame = GLStateStats();
+        total = GLStateStats();
+    }
+
+
+    static void UseProgram( unsigned int id )
+    {
+        if ( Filter( program == id ) )
+            return;
+        program = id;
+        glUseProgram( id );
+    }
+
+
+    static void BindVertexArray( unsigned int id )
+    {
+        if ( Filter( vertexArray == id ) )
+            return;
+        vertexArray = id;
+        glBindVertexArray( id );
+        // The element buffer binding is part of the VAO.
+        buffers[BufferSlot( GL_ELEMENT_ARRAY_BUFFER )] = UNKNOWN;
+    }
+
+
+    static void BindBuffer( unsigned int target, unsigned int id )
+    {
+        int slot = BufferSlot( target );
+        if ( slot < 0 )
+        {
+            Issue();
+            glBindBuffer( target, id );
+            return;
+        }
+        if ( Filter( buffers[slot] == id ) )
+            return;
+        buffers[slot] = id;
+        glBindBuffer( target, id );
+    }
+
+
+    // Only GL_UNIFORM_BUFFER bindings below MAX_UNIFORM_BINDINGS are tracked. Like GL,
+    // this also changes the generic binding of the target.
+    static void BindBufferRange( unsigned int target, unsigned int index, unsigned int id, size_t offset, size_t size )
+    {
+        bool tracked = target == GL_UNIFORM_BUFFER && index < MAX_UNIFORM_BINDINGS;
+        if ( tracked )
+        {
+            IndexedBinding& binding = uniformBindings[index];
+            if ( Filter( binding.id == id && binding.offset == offset && binding.size == size ) )
+                return;
+            binding = { id, offset, size };
+        }
+        else
+            Issue();
+        int slot = BufferSlot( target );
+        if ( slot >= 0 )
+            buffers[slot] = id;
+        glBindBufferRange( target, index, id, offset, size );
+    }
+
+
+    static void BindFramebuffer( unsigned int target, unsigned int id )
+    {
+        bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+        bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+        if ( Filter( ( !draw || framebuffers[0] == id ) && ( !read || framebuffers[1] == id ) ) )
+            return;
+        if ( draw )
+            framebuffers[0] = id;
+        if ( read )
+            framebuffers[1] = id;
+        glBindFramebuffer( target, id );
+    }
+
+
+    static void BindTexture( unsigned int unit, unsigned int target, unsigned int id )
+    {
+        int slot = TextureSlot( target );
+        if ( slot >= 0 && unit < MAX_TEXTURE_UNITS && Filter( textures[unit][slot] == id ) )
+            return;
+        if ( activeTextureUnit != unit )
+        {
+            Issue();
+            activeTextureUnit = unit;
+            glActiveTexture( GL_TEXTURE0 + unit );
+        }
+        if ( slot >= 0 && unit < MAX_TEXTURE_UNITS )
+            textures[unit][slot] = id;
+        else
+            Issue();
+        glBindTexture( target, id );
+    }
+
+
+    // Only GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_SCISSOR_TEST are tracked.
+    static void SetEnabled( unsigned int capability, bool enabled )
+    {
+        int slot = CapabilitySlot( capability );
+        if ( slot >= 0 && Filter( capabilities[slot] == (int) enabled ) )
+            return;
+        if ( slot >= 0 )
+            capabilities[slot] = enabled;
+        else
+            Issue();
+        if ( enabled )
+            glEnable( capability );
+        else
+            glDisable( capability );
+    }
+
+
+    static void BlendFunc( unsigned int source, unsigned int destination )
+    {
+        if ( Filter( blendSource == source && blendDestination == destination ) )
+            return;
+        blendSource = source;
+        blendDestination = destination;
+        glBlendFunc( source, destination );
+    }
+
+
+    static void DepthFunc( unsigned int function )
+    {
+        if ( Filter( depthFunction == function ) )
+            return;
+        depthFunction = function;
+        glDepthFunc( function );
+    }
+
+
+    static void CullFace( unsigned int mode )
+    {
+        if ( Filter( cullFaceMode == mode ) )
+            return;
+        cullFaceMode = mode;
+        glCullFace( mode );
+    }
+
+
+    static void Viewport( int x, int y, int width, int height )
+    {
+        if ( Filter( viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height ) )
+            return;
+        viewport[0] = x;
+        viewport[1] = y;
+        viewport[2] = width;
+        viewport[3] = height;
+        glViewport( x, y, width, height );
+    }
+
+
+    static void ClearColor( float r, float g, float b, float a )
+    {
+        if ( Filter( clearColorKnown && clearColor[0] == r && clearColor[1] == g && clearColor[2] == b && clearColor[3] == a ) )
+            return;
+        clearColorKnown = true;
+        clearColor[0] = r;
+        clearColor[1] = g;
+        clearColor[2] = b;
+        clearColor[3] = a;
+        glClearColor( r, g, b, a );
+    }
+
+
+    // Deleting a bound object implicitly rebinds 0, so forget it before GL does.
+    static void DeleteProgram( unsigned int id )
+    {
+        if ( program == id )
+            program = UNKNOWN;
+        glDeleteProgram( id );
+    }
+
+
+    static void DeleteVertexArray( unsigned int id )
+    {
+        if ( vertexArray == id )
+        {
+            vertexArray = UNKNOWN;
+            buffers[BufferSlot( GL_ELEMENT_ARRAY_BUFFER )] = UNKNOWN;
+        }
+        glDeleteVertexArrays( 1, &id );
+    }
+
+
+    static void DeleteBuffer( unsigned int id )
+    {
+        for ( unsigned int& buffer : buffers )
+            if ( buffer == id )
+                buffer = UNKNOWN;
+        for ( IndexedBinding& binding : uniformBindings )
+            if ( binding.id == id )
+                binding.id = UNKNOWN;
+        glDeleteBuffers( 1, &id );
+    }
+
+
+    static void DeleteFramebuffer( unsigned int id )
+    {
+        for ( unsigned int& framebuffer : framebuffers )
+            if ( framebuffer == id )
+                framebuffer = UNKNOWN;
+        glDeleteFramebuffers( 1, &id );
+    }
+
+
+private:
+    static const unsigned int UNKNOWN = 0xFFFFFFFF;
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const unsigned int MAX_UNIFORM_BINDINGS = 16;
+
+    struct IndexedBinding
+    {
+        unsigned int id;
+        size_t offset;
+        size_t size;
+    };
+
+    static inline unsigned int program = UNKNOWN;
+    static inline unsigned int vertexArray = UNKNOWN;
+    static inline unsigned int buffers[9] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+    static inline IndexedBinding uniformBindings[MAX_UNIFORM_BINDINGS];
+    static inline unsigned int framebuffers[2] = { UNKNOWN, UNKNOWN };
+    static inline unsigned int activeTextureUnit = UNKNOWN;
+    static inline unsigned int textures[MAX_TEXTURE_UNITS][4];
+    static inline int capabilities[4] = { -1, -1, -1, -1 };
+    static inline unsigned int blendSource = UNKNOWN;
+    static inline unsigned int blendDestination = UNKNOWN;
+    static inline unsigned int depthFunction = UNKNOWN;
+    static inline unsigned int cullFaceMode = UNKNOWN;
+    static inline int viewport[4] = { -1, -1, -1, -1 };
+    static inline float clearColor[4];
+    static inline bool clearColorKnown = false;
+
+
+    // Counts the call and returns true when it is redundant and should be dropped.
+    static bool Filter( bool redundant )
+    {
+        if ( redundant )
+        {
+            frame.filtered++;
+            total.filtered++;
+            return true;
+        }
+        Issue();
+        return false;
+    }
+
+
+    static void Issue()
+    {
+        frame.issued++;
+        total.issued++;
+    }
+
+
+    static int BufferSlot( unsigned int target )
+    {
+        switch ( target )
+        {
+            case GL_ARRAY_BUFFER: return 0;
+            case GL_ELEMENT_ARRAY_BUFFER: return 1;
+            case GL_UNIFORM_BUFFER: return 2;
+            case GL_COPY_READ_BUFFER: return 3;
+            case GL_COPY_WRITE_BUFFER: return 4;
+            case GL_PIXEL_PACK_BUFFER: return 5;
+            case GL_PIXEL_UNPACK_BUFFER: return 6;
+            case GL_TEXTURE_BUFFER: return 7;
+            case GL_DRAW_INDIRECT_BUFFER: return 8;
+            default: return -1;
+        }
+    }
+
+
+    static int TextureSlot( unsigned int target )
+    {
+        switch ( target )
+        {
+            case GL_TEXTURE_2D: return 0;
+            case GL_TEXTURE_2D_ARRAY: return 1;
+            case GL_TEXTURE_3D: return 2;
+            case GL_TEXTURE_CUBE_MAP: return 3;
+            default: return -1;
+        }
+    }
+
+
+    static int CapabilitySlot( unsigned int capability )
+    {
+        switch ( capability )
+        {
+            case GL_BLEND: return 0;
+            case GL_DEPTH_TEST: return 1;
+            case GL_CULL_FACE: return 2;
+            case GL_SCISSOR_TEST: return 3;
+            default: return -1;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include "glad/glad.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "gl_state_cache.h"
+
+
+// Window-less GL 3.3 core context for machines without a display.
+// Uses EGL on the Mesa surfaceless platform (llvmpipe when there is no GPU)
+// and renders into an offscreen framebuffer instead of a window back buffer.
+class HeadlessContext
+{
+public:
+    int width = 0;
+    int height = 0;
+    unsigned int framebuffer = 0;
+
+
+    int Init( int width, int height )
+    {
+        this->width = width;
+        this->height = height;
+
+        if ( CreateDisplay() != 0 || CreateContext() != 0 )
+        {
+            Terminate();
+            return -1;
+        }
+
+        if ( !gladLoadGLLoader( ( GLADloadproc ) eglGetProcAddress ) )
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            Terminate();
+            return -1;
+        }
+
+        if ( CreateFramebuffer() != 0 )
+        {
+            Terminate();
+            return -1;
+        }
+
+        std::cout << "Headless context: " << glGetString( GL_RENDERER ) << " (" << glGetString( GL_VERSION ) << ")" << std::endl;
+        return 0;
+    }
+
+
+    void Terminate()
+    {
+        if ( context != EGL_NO_CONTEXT )
+        {
+            if ( framebuffer != 0 )
+            {
+                GLStateCache::DeleteFramebuffer( framebuffer );
+                glDeleteRenderbuffers( 1, &colorRenderbuffer );
+                framebuffer = 0;
+                colorRenderbuffer = 0;
+            }
+            eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+            eglDestroyContext( display, context );
+            context = EGL_NO_CONTEXT;
+        }
+        if ( display != EGL_NO_DISPLAY )
+        {
+            eglTerminate( display );
+            display = EGL_NO_DISPLAY;
+        }
+    }
+
+
+    // Binds the context to the calling thread, or unbinds it from there. Returns false on failure.
+    bool MakeCurrent( bool current = true )
+    {
+        if ( current )
+            return eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context );
+        return eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+    }
+
+
+    // Stands in for a buffer swap: hands the frame to the driver without waiting on it.
+    void Present()
+    {
+        glFlush();
+    }
+
+
+    // Writes the current framebuffer contents as a binary PPM, top row first.
+    bool SaveFramebufferToFile( const std::string& filePath )
+    {
+        std::vector<unsigned char> pixels( (size_t) width * height * 4 );
+        GLStateCache::BindFramebuffer( GL_READ_FRAMEBUFFER, framebuffer );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+        glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data() );
+
+        std::ofstream file( filePath, std::ios::binary );
+        if ( !file.is_open() )
+        {
+            std::cerr << "Error opening the capture file! " << filePath << std::endl;
+            return false;
+        }
+
+        file << "P6\n" << width << " " << height << "\n255\n";
+        for ( int y = height - 1; y >= 0; y-- )
+            for ( int x = 0; x < width; x++ )
+                file.write( (const char*) &pixels[( (size_t) y * width + x ) * 4], 3 );
+        return true;
+    }
+
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    unsigned int colorRenderbuffer = 0;
+
+
+    int CreateDisplay()
+    {
+        const char* clientExtensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            ( PFNEGLGETPLATFORMDISPLAYEXTPROC ) eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+
+        if ( clientExtensions != NULL && strstr( clientExtensions, "EGL_MESA_platform_surfaceless" ) != NULL && getPlatformDisplay != NULL )
+            display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+        if ( display == EGL_NO_DISPLAY )
+            display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+        if ( display == EGL_NO_DISPLAY || !eglInitialize( display, NULL, NULL ) )
+        {
+            std::cout << "Failed to initialize EGL display" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return -1;
+        }
+        return 0;
+    }
+
+
+    int CreateContext()
+    {
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+
+        if ( !eglBindAPI( EGL_OPENGL_API ) )
+        {
+            std::cout << "Failed to bind the desktop OpenGL API" << std::endl;
+            return -1;
+        }
+
+        EGLConfig config;
+        EGLint configCount = 0;
+        if ( !eglChooseConfig( display, configAttributes, &config, 1, &configCount ) || configCount == 0 )
+        {
+            // Surfaceless displays may expose no pbuffer configs; any GL-renderable config will do.
+            const EGLint anyConfigAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+            if ( !eglChooseConfig( display, anyConfigAttributes, &config, 1, &configCount ) || configCount == 0 )
+            {
+                std::cout << "Failed to find an EGL config" << std::endl;
+                return -1;
+            }
+        }
+
+        context = eglCreateContext( display, config, EGL_NO_CONTEXT, contextAttributes );
+        if ( context == EGL_NO_CONTEXT )
+        {
+            std::cout << "Failed to create EGL context" << std::endl;
+            return -1;
+        }
+        if ( !eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context ) )
+        {
+            std::cout << "Failed to make EGL context current" << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+
+    int CreateFramebuffer()
+    {
+        glGenRenderbuffers( 1, &colorRenderbuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, colorRenderbuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+
+        glGenFramebuffers( 1, &framebuffer );
+        GLStateCache::BindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer );
+
+        if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+        {
+            std::cout << "Failed to create offscreen framebuffer" << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef INPUT_MAP_H
+#define INPUT_MAP_H
+
+#include <unordered_map>
+#include "input_queue.h"
+
+
+// Turns input events into the state of named actions. Keys and mouse buttons are bound to
+// action indices; each event is one lookup, however many bindings there are. Presses and
+// releases are counted per step, so a press and release that both land inside one step
+// still reach the simulation.
+//
+//   map.BindKey( GLFW_KEY_SPACE, ACTION_JUMP );
+//   map.BeginStep();
+//   map.Consume( queue, stepEndTime );
+//   if ( map.WasPressed( ACTION_JUMP ) ) ...
+class InputMap
+{
+public:
+    static const int MAX_ACTIONS = 64;
+
+    // Last cursor position in window pixels, and scrolling since BeginStep().
+    float cursorX = 0.0f;
+    float cursorY = 0.0f;
+    float scrollX = 0.0f;
+    float scrollY = 0.0f;
+
+    long long eventsConsumed = 0;
+
+
+    void BindKey( int key, int action )
+    {
+        bindings[MakeBinding( InputEvent::KEY, key )] = action;
+    }
+
+
+    void BindMouseButton( int button, int action )
+    {
+        bindings[MakeBinding( InputEvent::MOUSE_BUTTON, button )] = action;
+    }
+
+
+    // Starts counting presses, releases and scrolling anew; held actions stay down.
+    void BeginStep()
+    {
+        for ( ActionState& state : actions )
+            state.presses = state.releases = 0;
+        scrollX = scrollY = 0.0f;
+    }
+
+
+    // Applies the queued events that came in no later than until. Returns how many.
+    int Consume( InputQueue& queue, double until )
+    {
+        int count = 0;
+        InputEvent event;
+        while ( queue.Pop( event, until ) )
+        {
+            Apply( event );
+            count++;
+        }
+        eventsConsumed += count;
+        return count;
+    }
+
+
+    bool IsDown( int action ) const
+    {
+        return actions[action].down > 0;
+    }
+
+
+    bool WasPressed( int action ) const
+    {
+        return actions[action].presses > 0;
+    }
+
+
+    bool WasReleased( int action ) const
+    {
+        return actions[action].releases > 0;
+    }
+
+
+    // Down now, or tapped since BeginStep().
+    bool IsActive( int action ) const
+    {
+        return IsDown( action ) || WasPressed( action );
+    }
+
+
+    void Clear()
+    {
+        for ( ActionState& state : actions )
+            state = ActionState();
+        scrollX = scrollY = 0.0f;
+    }
+
+
+private:
+    struct ActionState
+    {
+        // Bound keys and buttons held; an action can have several.
+        int down = 0;
+        int presses = 0;
+        int releases = 0;
+    };
+
+    std::unordered_map<int, int> bindings;
+    ActionState actions[MAX_ACTIONS];
+
+
+    static int MakeBinding( int type, int code )
+    {
+        return type << 16 | ( code & 0xFFFF );
+    }
+
+
+    void Apply( const InputEvent& event )
+    {
+        if ( event.type == InputEvent::CURSOR )
+        {
+            cursorX = event.x;
+            cursorY = event.y;
+            return;
+        }
+        if ( event.type == InputEvent::SCROLL )
+        {
+            scrollX += event.x;
+            scrollY += event.y;
+            return;
+        }
+        auto binding = bindings.find( MakeBinding( event.type, event.code ) );
+        if ( binding == bindings.end() || binding->second < 0 || binding->second >= MAX_ACTIONS )
+            return;
+        ActionState& state = actions[binding->second];
+        if ( event.pressed )
+        {
+            if ( state.down++ == 0 )
+                state.presses++;
+        }
+        // A key held since before the window opened is released without ever being pressed.
+        else if ( state.down > 0 && --state.down == 0 )
+            state.releases++;
+    }
+};
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+
+struct InputEvent
+{
+    static const int KEY = 0;
+    static const int MOUSE_BUTTON = 1;
+    static const int CURSOR = 2;
+    static const int SCROLL = 3;
+
+    // Seconds on the window system's clock, when the event came in.
+    double time = 0.0;
+    int type = KEY;
+    // Key or mouse button; unused for cursor and scroll events.
+    int code = 0;
+    bool pressed = false;
+    int mods = 0;
+    // Cursor position in window pixels, or scroll offsets.
+    float x = 0.0f;
+    float y = 0.0f;
+};
+
+
+// Fixed-size ring of input events with one producer, the window system's callbacks, and one
+// consumer, which may be on another thread. Neither side locks: the producer publishes an
+// event by moving the tail past it, the consumer frees its slot by moving the head. A full
+// queue drops new events rather than blocking the window system.
+class InputQueue
+{
+public:
+    static const int CAPACITY = 1024;
+
+    // Producer side: events lost to a full queue.
+    long long dropped = 0;
+
+
+    // Producer only.
+    bool Push( const InputEvent& event )
+    {
+        size_t t = tail.load( std::memory_order_relaxed );
+        if ( t - head.load( std::memory_order_acquire ) >= (size_t) CAPACITY )
+        {
+            dropped++;
+            return false;
+        }
+        events[t & ( CAPACITY - 1 )] = event;
+        tail.store( t + 1, std::memory_order_release );
+        return true;
+    }
+
+
+    // Consumer only: takes the oldest event if it came in no later than until.
+    bool Pop( InputEvent& event, double until )
+    {
+        size_t h = head.load( std::memory_order_relaxed );
+        if ( h == tail.load( std::memory_order_acquire ) )
+            return false;
+        const InputEvent& next = events[h & ( CAPACITY - 1 )];
+        if ( next.time > until )
+            return false;
+        event = next;
+        head.store( h + 1, std::memory_order_release );
+        return true;
+    }
+
+
+private:
+    alignas( 64 ) std::atomic<size_t> head { 0 };
+    alignas( 64 ) std::atomic<size_t> tail { 0 };
+    InputEvent events[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,470 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+class JobSystem;
+
+
+// A small callable with the counter it reports to. Jobs live in fixed per-thread rings, so
+// what a job captures has to fit in DATA_SIZE bytes; capture pointers to anything larger.
+struct Job
+{
+    static const int DATA_SIZE = 48;
+
+    void ( *run )( Job& job ) = nullptr;
+    class JobCounter* counter = nullptr;
+    std::atomic<bool> inUse { false };
+    alignas( 16 ) unsigned char data[DATA_SIZE];
+};
+
+
+// Counts the jobs started against it that have not finished yet. JobSystem::Wait() returns
+// once it drops to zero, and jobs started with it as their dependency are held back until
+// then. A counter can be reused once it is done.
+class JobCounter
+{
+public:
+    JobCounter() = default;
+    JobCounter( const JobCounter& ) = delete;
+    JobCounter& operator=( const JobCounter& ) = delete;
+
+
+    bool IsDone() const
+    {
+        return pending.load() == 0;
+    }
+
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> pending { 0 };
+    // Only taken for the last job's finish and for jobs waiting on this counter, so the
+    // counter cannot be released while the last job still holds it.
+    std::mutex mutex;
+    std::vector<Job*> waiting;
+};
+
+
+// Chase-Lev work-stealing deque of a fixed size. The owning thread pushes and pops at the
+// bottom; any other thread steals from the top. Sequentially consistent throughout: the
+// fences of the relaxed version save little on x86 and hide the ordering from race checkers.
+class JobDeque
+{
+public:
+    static const int CAPACITY = 4096;
+
+
+    // False when full.
+    bool Push( Job* job )
+    {
+        long long b = bottom.load();
+        if ( b - top.load() >= CAPACITY )
+            return false;
+        slots[b & ( CAPACITY - 1 )].store( job );
+        bottom.store( b + 1 );
+        return true;
+    }
+
+
+    Job* Pop()
+    {
+        long long b = bottom.load() - 1;
+        bottom.store( b );
+        long long t = top.load();
+        if ( t > b )
+        {
+            bottom.store( b + 1 );
+            return nullptr;
+        }
+        Job* job = slots[b & ( CAPACITY - 1 )].load();
+        if ( t == b )
+        {
+            // The last job: a thief may be after it too, and the top decides.
+            if ( !top.compare_exchange_strong( t, t + 1 ) )
+                job = nullptr;
+            bottom.store( b + 1 );
+        }
+        return job;
+    }
+
+
+    Job* Steal()
+    {
+        long long t = top.load();
+        long long b = bottom.load();
+        if ( t >= b )
+            return nullptr;
+        Job* job = slots[t & ( CAPACITY - 1 )].load();
+        if ( !top.compare_exchange_strong( t, t + 1 ) )
+            return nullptr;
+        return job;
+    }
+
+
+    bool IsEmpty() const
+    {
+        return bottom.load() <= top.load();
+    }
+
+
+private:
+    alignas( 64 ) std::atomic<long long> top { 0 };
+    alignas( 64 ) std::atomic<long long> bottom { 0 };
+    alignas( 64 ) std::atomic<Job*> slots[CAPACITY] = {};
+};
+
+
+// A fixed pool of worker threads sharing work through per-thread deques. Each thread runs
+// its own jobs newest first and, when out of work, steals the oldest job of another. A
+// thread waiting on a counter runs jobs until it is done rather than blocking, so the
+// calling thread helps and jobs may wait on jobs they started.
+//
+// Jobs are started from the thread that called Init() or from inside other jobs.
+//
+//   jobs.Init();
+//   JobCounter loaded;
+//   jobs.Run( [&]() { Load(); }, loaded );
+//   jobs.ParallelFor( 0, count, 256, [&]( int begin, int end ) { Update( begin, end ); } );
+//   jobs.Wait( loaded );
+class JobSystem
+{
+public:
+    // Ring of job slots per thread; a thread starting more jobs than this before the oldest
+    // has finished runs jobs until a slot frees up.
+    static const int JOBS_PER_THREAD = 4096;
+
+
+    ~JobSystem()
+    {
+        Unload();
+    }
+
+
+    // threadCount includes the calling thread; 0 uses one per hardware thread.
+    void Init( int threadCount = 0 )
+    {
+        Unload();
+        if ( threadCount <= 0 )
+            threadCount = (int) std::max( std::thread::hardware_concurrency(), 1u );
+        this->threadCount = threadCount;
+        threads.reset( new ThreadState[threadCount] );
+        stopping = false;
+        CurrentThread() = { this, 0 };
+        for ( int i = 1; i < threadCount; i++ )
+            threads[i].thread = std::thread( &JobSystem::WorkerLoop, this, i );
+    }
+
+
+    void Unload()
+    {
+        if ( !threads )
+            return;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            stopping = true;
+        }
+        wake.notify_all();
+        for ( int i = 1; i < threadCount; i++ )
+            threads[i].thread.join();
+        if ( CurrentThread().system == this )
+            CurrentThread() = {};
+        threads.reset();
+        threadCount = 0;
+    }
+
+
+    int GetThreadCount() const
+    {
+        return threadCount;
+    }
+
+
+    // Totals since Init().
+    long long GetJobCount() const
+    {
+        long long total = 0;
+        for ( int i = 0; i < threadCount; i++ )
+            total += threads[i].jobsRun.load( std::memory_order_relaxed );
+        return total;
+    }
+
+
+    long long GetStealCount() const
+    {
+        long long total = 0;
+        for ( int i = 0; i < threadCount; i++ )
+            total += threads[i].steals.load( std::memory_order_relaxed );
+        return total;
+    }
+
+
+    // Queues function to run on some thread and counts it against counter. With a
+    // dependency, it is held back until that counter is done.
+    template <typename Function>
+    void Run( Function&& function, JobCounter& counter, JobCounter* dependency = nullptr )
+    {
+        typedef typename std::decay<Function>::type Callable;
+        static_assert( sizeof( Callable ) <= Job::DATA_SIZE, "Job captures too much, capture a pointer instead" );
+        static_assert( alignof( Callable ) <= 16, "Job capture is over-aligned" );
+
+        int thread = GetThreadIndex();
+        Job* job = AllocateJob( thread );
+        new ( job->data ) Callable( std::forward<Function>( function ) );
+        job->run = []( Job& job )
+        {
+            Callable* callable = reinterpret_cast<Callable*>( job.data );
+            ( *callable )();
+            callable->~Callable();
+        };
+        job->counter = &counter;
+        counter.pending++;
+
+        if ( dependency != nullptr )
+        {
+            std::lock_guard<std::mutex> lock( dependency->mutex );
+            if ( dependency->pending.load() > 0 )
+            {
+                dependency->waiting.push_back( job );
+                return;
+            }
+        }
+        Push( thread, job );
+    }
+
+
+    // Runs jobs until counter is done.
+    void Wait( JobCounter& counter )
+    {
+        int thread = GetThreadIndex();
+        while ( !counter.IsDone() )
+        {
+            Job* job = FindJob( thread );
+            if ( job != nullptr )
+                Execute( thread, job );
+            else
+                std::this_thread::yield();
+        }
+        // The last job drops the count while holding the lock; wait for it to let go.
+        std::lock_guard<std::mutex> lock( counter.mutex );
+    }
+
+
+    // Calls function( begin, end ) over [begin, end) in pieces of at most grain indices.
+    // Pieces are split off by halving, so a thief takes half of what is left rather than
+    // one piece, and returns once every piece has run.
+    template <typename Function>
+    void ParallelFor( int begin, int end, int grain, const Function& function )
+    {
+        if ( end <= begin )
+            return;
+        grain = std::max( grain, 1 );
+        if ( threadCount <= 1 || end - begin <= grain )
+        {
+            function( begin, end );
+            return;
+        }
+        JobCounter counter;
+        RunRange( &function, begin, end, grain, &counter );
+        Wait( counter );
+    }
+
+
+private:
+    struct ThreadState
+    {
+        JobDeque deque;
+        Job jobs[JOBS_PER_THREAD];
+        unsigned int nextJob = 0;
+        unsigned int random = 0;
+        std::atomic<long long> jobsRun { 0 };
+        std::atomic<long long> steals { 0 };
+        std::thread thread;
+    };
+
+    struct CurrentThreadState
+    {
+        const JobSystem* system = nullptr;
+        int index = 0;
+    };
+
+    std::unique_ptr<ThreadState[]> threads;
+    int threadCount = 0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<int> sleepers { 0 };
+    bool stopping = false;
+
+
+    static CurrentThreadState& CurrentThread()
+    {
+        thread_local CurrentThreadState current;
+        return current;
+    }
+
+
+    // Workers know their own index; any other thread counts as the one that called Init().
+    int GetThreadIndex() const
+    {
+        const CurrentThreadState& current = CurrentThread();
+        return current.system == this ? current.index : 0;
+    }
+
+
+    template <typename Function>
+    void RunRange( const Function* function, int begin, int end, int grain, JobCounter* counter )
+    {
+        Run( [this, function, begin, end, grain, counter]()
+        {
+            int last = end;
+            while ( last - begin > grain )
+            {
+                int middle = begin + ( last - begin ) / 2;
+                RunRange( function, middle, last, grain, counter );
+                last = middle;
+            }
+            ( *function )( begin, last );
+        }, *counter );
+    }
+
+
+    Job* AllocateJob( int thread )
+    {
+        ThreadState& state = threads[thread];
+        Job* job = &state.jobs[state.nextJob++ & ( JOBS_PER_THREAD - 1 )];
+        while ( job->inUse.load() )
+        {
+            Job* other = FindJob( thread );
+            if ( other != nullptr )
+                Execute( thread, other );
+            else
+                std::this_thread::yield();
+        }
+        job->inUse = true;
+        return job;
+    }
+
+
+    void Push( int thread, Job* job )
+    {
+        if ( !threads[thread].deque.Push( job ) )
+        {
+            Execute( thread, job );
+            return;
+        }
+        if ( sleepers.load() > 0 )
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            wake.notify_one();
+        }
+    }
+
+
+    Job* FindJob( int thread )
+    {
+        ThreadState& state = threads[thread];
+        Job* job = state.deque.Pop();
+        if ( job != nullptr || threadCount <= 1 )
+            return job;
+        // Start at a random victim so thieves do not all pile onto the same deque.
+        state.random = state.random * 1664525u + 1013904223u;
+        int first = (int) ( ( state.random >> 16 ) % (unsigned int) threadCount );
+        for ( int i = 0; i < threadCount; i++ )
+        {
+            int victim = ( first + i ) % threadCount;
+            if ( victim == thread )
+                continue;
+            job = threads[victim].deque.Steal();
+            if ( job != nullptr )
+            {
+                state.steals.store( state.steals.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+                return job;
+            }
+        }
+        return nullptr;
+    }
+
+
+    void Execute( int thread, Job* job )
+    {
+        job->run( *job );
+        ThreadState& state = threads[thread];
+        state.jobsRun.store( state.jobsRun.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        JobCounter* counter = job->counter;
+        job->inUse = false;
+        Finish( thread, *counter );
+    }
+
+
+    // Counts a job off. Only the drop to zero takes the lock, and it releases the jobs
+    // that were waiting on the counter.
+    void Finish( int thread, JobCounter& counter )
+    {
+        int pending = counter.pending.load();
+        while ( pending > 1 )
+            if ( counter.pending.compare_exchange_weak( pending, pending - 1 ) )
+                return;
+
+        std::vector<Job*> released;
+        {
+            std::lock_guard<std::mutex> lock( counter.mutex );
+            if ( counter.pending.fetch_sub( 1 ) == 1 )
+                released.swap( counter.waiting );
+        }
+        for ( Job* job : released )
+            Push( thread, job );
+    }
+
+
+    bool HasQueuedJobs() const
+    {
+        for ( int i = 0; i < threadCount; i++ )
+            if ( !threads[i].deque.IsEmpty() )
+                return true;
+        return false;
+    }
+
+
+    void WorkerLoop( int index )
+    {
+        CurrentThread() = { this, index };
+        threads[index].random = (unsigned int) index * 2654435761u;
+        int idle = 0;
+        while ( true )
+        {
+            Job* job = FindJob( index );
+            if ( job != nullptr )
+            {
+                Execute( index, job );
+                idle = 0;
+                continue;
+            }
+            // Spin briefly, since more work usually follows within the frame, then sleep.
+            if ( ++idle < 64 )
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock( mutex );
+            sleepers++;
+            wake.wait( lock, [this]() { return stopping || HasQueuedJobs(); } );
+            sleepers--;
+            if ( stopping )
+                return;
+            idle = 0;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "mesh_registry.h"
+
+
+// Picks a level of detail per object: the coarsest level whose error, projected to the
+// screen, stays under pixelError. An object only moves to a coarser level once that
+// level is comfortably under the limit, by the hysteresis fraction, so objects sitting
+// near a boundary do not flip between two levels every frame. Moving to a finer level
+// happens as soon as the current one is over the limit.
+//
+//   selector.Resize( objectCount );
+//   int lod = selector.Select( object, mesh, LodSelector::PixelsPerUnit( scale, distance, fov, height ) );
+class LodSelector
+{
+public:
+    // Largest error allowed on screen, in pixels.
+    float pixelError = 1.0f;
+    // How far under pixelError a coarser level has to be before it is picked.
+    float hysteresis = 0.25f;
+
+    // Totals since Resize().
+    long long selections = 0;
+    long long levelChanges = 0;
+    long long selectionsPerLevel[Mesh::MAX_LODS] = {};
+
+
+    // Starts every object at the full mesh.
+    void Resize( int objectCount )
+    {
+        levels.assign( objectCount, 0 );
+        selections = levelChanges = 0;
+        std::fill( selectionsPerLevel, selectionsPerLevel + Mesh::MAX_LODS, 0 );
+    }
+
+
+    // Screen pixels per model unit for a perspective view: scale is the model's world scale,
+    // distance its distance from the eye, verticalFov in radians.
+    static float PixelsPerUnit( float scale, float distance, float verticalFov, int viewportHeight )
+    {
+        return scale * viewportHeight / ( 2.0f * distance * std::tan( verticalFov * 0.5f ) );
+    }
+
+
+    // The same for a model drawn straight into clip space, as the benchmark scenes are.
+    static float PixelsPerUnit( float clipScale, int viewportHeight )
+    {
+        return clipScale * viewportHeight * 0.5f;
+    }
+
+
+    int Select( int object, const Mesh& mesh, float pixelsPerUnit )
+    {
+        int current = std::min( (int) levels[object], mesh.lodCount - 1 );
+        int level = 0;
+        for ( int i = 1; i < mesh.lodCount; i++ )
+            if ( mesh.lods[i].error * pixelsPerUnit <= pixelError )
+                level = i;
+        while ( level > current && mesh.lods[level].error * pixelsPerUnit > pixelError * ( 1.0f - hysteresis ) )
+            level--;
+
+        selections++;
+        selectionsPerLevel[level]++;
+        levelChanges += level != levels[object];
+        levels[object] = (uint8_t) level;
+        return level;
+    }
+
+
+private:
+    std::vector<uint8_t> levels;
+};
+
+#endif
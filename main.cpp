@@ -1,4 +1,6 @@
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 #include "glad/glad.h"
 #include <GLFW/glfw3.h>
 #include "banana_engine.cpp"
@@ -6,8 +8,97 @@
 
 int main( int argc, char* argv[] )
 {
+    EngineSettings settings;
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( strcmp( argv[i], "--headless" ) == 0 )
+            settings.headless = true;
+        else if ( strcmp( argv[i], "--frames" ) == 0 && i + 1 < argc )
+            settings.maxFrames = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--width" ) == 0 && i + 1 < argc )
+            settings.width = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--height" ) == 0 && i + 1 < argc )
+            settings.height = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--capture" ) == 0 && i + 1 < argc )
+            settings.captureFile = argv[++i];
+        else if ( strcmp( argv[i], "--quads" ) == 0 && i + 1 < argc )
+            settings.quadCount = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--per-object" ) == 0 )
+            settings.perObjectQuads = true;
+        else if ( strcmp( argv[i], "--no-persistent-mapping" ) == 0 )
+            settings.persistentMapping = false;
+        else if ( strcmp( argv[i], "--float-vertices" ) == 0 )
+            settings.compactVertices = false;
+        else if ( strcmp( argv[i], "--submit" ) == 0 && i + 1 < argc )
+        {
+            i++;
+            if ( strcmp( argv[i], "per-draw" ) == 0 )
+                settings.drawSubmission = 0;
+            else if ( strcmp( argv[i], "multi-draw" ) == 0 )
+                settings.drawSubmission = 1;
+            else if ( strcmp( argv[i], "indirect" ) == 0 )
+                settings.drawSubmission = 2;
+            else
+                std::cout << "Unknown submit mode " << argv[i] << ", expected per-draw, multi-draw or indirect" << std::endl;
+        }
+        else if ( strcmp( argv[i], "--sphere" ) == 0 && i + 1 < argc )
+            settings.sphereSegments = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--no-mesh-optimization" ) == 0 )
+            settings.optimizeMeshes = false;
+        else if ( strcmp( argv[i], "--mesh-churn" ) == 0 && i + 1 < argc )
+            settings.meshChurn = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--no-lod" ) == 0 )
+            settings.lod = false;
+        else if ( strcmp( argv[i], "--lod-error" ) == 0 && i + 1 < argc )
+            settings.lodPixelError = (float) atof( argv[++i] );
+        else if ( strcmp( argv[i], "--sim-hz" ) == 0 && i + 1 < argc )
+            settings.simulationHz = atof( argv[++i] );
+        else if ( strcmp( argv[i], "--max-sim-steps" ) == 0 && i + 1 < argc )
+            settings.maxSimulationSteps = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--no-render" ) == 0 )
+            settings.rendering = false;
+        else if ( strcmp( argv[i], "--no-render-thread" ) == 0 )
+            settings.renderThread = false;
+        else if ( strcmp( argv[i], "--job-threads" ) == 0 && i + 1 < argc )
+            settings.jobThreads = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--no-vsync" ) == 0 )
+            settings.vsync = FramePacer::VSYNC_OFF;
+        else if ( strcmp( argv[i], "--vsync" ) == 0 && i + 1 < argc )
+        {
+            i++;
+            if ( strcmp( argv[i], "off" ) == 0 )
+                settings.vsync = FramePacer::VSYNC_OFF;
+            else if ( strcmp( argv[i], "on" ) == 0 )
+                settings.vsync = FramePacer::VSYNC_ON;
+            else if ( strcmp( argv[i], "adaptive" ) == 0 )
+                settings.vsync = FramePacer::VSYNC_ADAPTIVE;
+            else
+                std::cout << "Unknown vsync mode " << argv[i] << ", expected off, on or adaptive" << std::endl;
+        }
+        else if ( strcmp( argv[i], "--max-fps" ) == 0 && i + 1 < argc )
+            settings.maxFps = atof( argv[++i] );
+        else if ( strcmp( argv[i], "--frames-in-flight" ) == 0 && i + 1 < argc )
+            settings.maxFramesInFlight = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--no-dynamic-resolution" ) == 0 )
+            settings.dynamicResolution = false;
+        else if ( strcmp( argv[i], "--min-render-scale" ) == 0 && i + 1 < argc )
+            settings.minRenderScale = (float) atof( argv[++i] );
+        else if ( strcmp( argv[i], "--max-render-scale" ) == 0 && i + 1 < argc )
+            settings.maxRenderScale = (float) atof( argv[++i] );
+        else if ( strcmp( argv[i], "--target-gpu-ms" ) == 0 && i + 1 < argc )
+            settings.targetGpuMs = (float) atof( argv[++i] );
+        else if ( strcmp( argv[i], "--profile" ) == 0 )
+            settings.profile = true;
+        else if ( strcmp( argv[i], "--trace" ) == 0 && i + 1 < argc )
+            settings.traceFile = argv[++i];
+        else
+            std::cout << "Ignoring unknown argument: " << argv[i] << std::endl;
+    }
+    if ( settings.headless && settings.maxFrames <= 0 )
+        settings.maxFrames = 1000;
+
     BananaEngine engine = BananaEngine();
-    engine.Start();
+    engine.Start( settings );
     return 0;
 }
 
@@ -0,0 +1,632 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cfloat>
+#include <cstring>
+#include <vector>
+
+
+struct VertexCacheStats
+{
+    // Average cache miss ratio: transformed vertices per triangle, 0.5 at best, 3 at worst.
+    double acmr = 0.0;
+    // Average transform to vertex ratio: transformed vertices per unique vertex, 1 at best.
+    double atvr = 0.0;
+};
+
+
+// Index and vertex reordering for triangle lists, meant to run once when a mesh is
+// loaded or imported. The usual order is OptimizeVertexCache(), then OptimizeOverdraw()
+// (which keeps most of the cache win), then OptimizeVertexFetch() last, since it
+// renumbers the vertices. None of them change what is drawn, only the order. Simplify()
+// is the exception: it builds coarser index lists over the same vertices, for levels of detail.
+class MeshOptimizer
+{
+public:
+    // Simulated post-transform cache size; small enough to model most hardware.
+    static const int CACHE_SIZE = 16;
+
+
+    // FIFO cache simulation over a triangle list.
+    static VertexCacheStats AnalyzeVertexCache( const std::vector<unsigned int>& indices, size_t vertexCount, int cacheSize = CACHE_SIZE )
+    {
+        VertexCacheStats stats;
+        if ( indices.size() < 3 )
+            return stats;
+
+        // A vertex is cached while fewer than cacheSize misses happened since it was loaded.
+        std::vector<size_t> loadedAt( vertexCount, 0 );
+        std::vector<bool> seen( vertexCount, false );
+        size_t misses = 0;
+        size_t unique = 0;
+        for ( unsigned int index : indices )
+        {
+            if ( !seen[index] )
+            {
+                seen[index] = true;
+                unique++;
+            }
+            else if ( misses - loadedAt[index] < (size_t) cacheSize )
+                continue;
+            loadedAt[index] = misses;
+            misses++;
+        }
+        stats.acmr = (double) misses / ( indices.size() / 3 );
+        stats.atvr = unique > 0 ? (double) misses / unique : 0.0;
+        return stats;
+    }
+
+
+    // Tom Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle
+    // whose vertices score highest for sitting in an LRU cache and having few triangles left.
+    static void OptimizeVertexCache( std::vector<unsigned int>& indices, size_t vertexCount )
+    {
+        const int lruSize = 32;
+        size_t triangleCount = indices.size() / 3;
+        if ( triangleCount == 0 )
+            return;
+
+        // Triangles using each vertex, as a compact adjacency list.
+        std::vector<unsigned int> triangleOffsets( vertexCount + 1, 0 );
+        for ( unsigned int index : indices )
+            triangleOffsets[index + 1]++;
+        for ( size_t v = 0; v < vertexCount; v++ )
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        std::vector<unsigned int> adjacency( indices.size() );
+        std::vector<unsigned int> fill( triangleOffsets.begin(), triangleOffsets.end() - 1 );
+        for ( size_t i = 0; i < indices.size(); i++ )
+            adjacency[fill[indices[i]]++] = (unsigned int) ( i / 3 );
+
+        std::vector<unsigned int> remaining( vertexCount );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            remaining[v] = triangleOffsets[v + 1] - triangleOffsets[v];
+        std::vector<int> cachePosition( vertexCount, -1 );
+        std::vector<float> vertexScore( vertexCount );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            vertexScore[v] = ForsythScore( -1, remaining[v], lruSize );
+
+        std::vector<float> triangleScore( triangleCount );
+        std::vector<bool> emitted( triangleCount, false );
+        for ( size_t t = 0; t < triangleCount; t++ )
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+        std::vector<unsigned int> output;
+        output.reserve( indices.size() );
+        std::vector<unsigned int> cache;
+        std::vector<unsigned int> nextCache;
+        size_t scanCursor = 0;
+        long long best = -1;
+
+        for ( size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++ )
+        {
+            if ( best < 0 )
+            {
+                // Nothing in the cache touches a live triangle: take the best-scored one left.
+                float bestScore = -1.0f;
+                for ( size_t t = scanCursor; t < triangleCount; t++ )
+                    if ( !emitted[t] && triangleScore[t] > bestScore )
+                    {
+                        bestScore = triangleScore[t];
+                        best = (long long) t;
+                    }
+                while ( scanCursor < triangleCount && emitted[scanCursor] )
+                    scanCursor++;
+            }
+
+            size_t triangle = (size_t) best;
+            emitted[triangle] = true;
+            const unsigned int* corners = &indices[triangle * 3];
+            output.insert( output.end(), corners, corners + 3 );
+
+            // Move the corners to the front of the LRU cache and drop the triangle from their lists.
+            nextCache.assign( corners, corners + 3 );
+            for ( unsigned int vertex : cache )
+                if ( vertex != corners[0] && vertex != corners[1] && vertex != corners[2] )
+                    nextCache.push_back( vertex );
+            for ( int c = 0; c < 3; c++ )
+            {
+                unsigned int vertex = corners[c];
+                unsigned int* list = &adjacency[triangleOffsets[vertex]];
+                unsigned int count = remaining[vertex];
+                for ( unsigned int i = 0; i < count; i++ )
+                    if ( list[i] == triangle )
+                    {
+                        list[i] = list[count - 1];
+                        break;
+                    }
+                remaining[vertex]--;
+            }
+
+            // Rescore every vertex that was or is in the cache, then the triangles around them.
+            for ( size_t i = 0; i < nextCache.size(); i++ )
+            {
+                unsigned int vertex = nextCache[i];
+                cachePosition[vertex] = i < (size_t) lruSize ? (int) i : -1;
+                vertexScore[vertex] = ForsythScore( cachePosition[vertex], remaining[vertex], lruSize );
+            }
+            best = -1;
+            float bestScore = -1.0f;
+            for ( size_t i = 0; i < nextCache.size() && i < (size_t) lruSize; i++ )
+            {
+                unsigned int vertex = nextCache[i];
+                const unsigned int* list = &adjacency[triangleOffsets[vertex]];
+                for ( unsigned int j = 0; j < remaining[vertex]; j++ )
+                {
+                    unsigned int t = list[j];
+                    float score = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                    triangleScore[t] = score;
+                    if ( score > bestScore )
+                    {
+                        bestScore = score;
+                        best = t;
+                    }
+                }
+            }
+            if ( nextCache.size() > (size_t) lruSize )
+                nextCache.resize( lruSize );
+            cache.swap( nextCache );
+        }
+        indices.swap( output );
+    }
+
+
+    // Reorders clusters of the (already cache-optimised) triangle list so that surfaces
+    // facing outwards from the mesh centre are drawn first, after Sander et al. 2007.
+    // Clusters start wherever the cache simulation restarts, and are split further while
+    // that keeps the ACMR within threshold of the input's. positions holds x, y, z floats
+    // every positionStride floats.
+    static void OptimizeOverdraw( std::vector<unsigned int>& indices, const float* positions, size_t positionStride, size_t vertexCount, float threshold = 1.05f )
+    {
+        size_t triangleCount = indices.size() / 3;
+        if ( triangleCount < 2 )
+            return;
+
+        std::vector<size_t> clusterStarts = FindClusters( indices, vertexCount, threshold );
+
+        float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+        for ( size_t v = 0; v < vertexCount; v++ )
+            for ( int axis = 0; axis < 3; axis++ )
+                meshCentroid[axis] += positions[v * positionStride + axis] / vertexCount;
+
+        struct Cluster
+        {
+            size_t start;
+            size_t end;
+            float sortKey;
+        };
+        std::vector<Cluster> clusters;
+        for ( size_t c = 0; c < clusterStarts.size(); c++ )
+        {
+            size_t start = clusterStarts[c];
+            size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+            // Area-weighted centroid and normal of the cluster.
+            float centroid[3] = { 0.0f, 0.0f, 0.0f };
+            float normal[3] = { 0.0f, 0.0f, 0.0f };
+            float totalArea = 0.0f;
+            for ( size_t t = start; t < end; t++ )
+            {
+                const float* a = &positions[indices[t * 3] * positionStride];
+                const float* b = &positions[indices[t * 3 + 1] * positionStride];
+                const float* p = &positions[indices[t * 3 + 2] * positionStride];
+                float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+                float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+                float cross[3] = { ab[1] * ap[2] - ab[2] * ap[1], ab[2] * ap[0] - ab[0] * ap[2], ab[0] * ap[1] - ab[1] * ap[0] };
+                float area = std::sqrt( cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2] );
+                for ( int axis = 0; axis < 3; axis++ )
+                {
+                    centroid[axis] += ( a[axis] + b[axis] + p[axis] ) / 3.0f * area;
+                    normal[axis] += cross[axis];
+                }
+                totalArea += area;
+            }
+            float normalLength = std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+            float sortKey = 0.0f;
+            if ( totalArea > 0.0f && normalLength > 0.0f )
+                for ( int axis = 0; axis < 3; axis++ )
+                    sortKey += ( centroid[axis] / totalArea - meshCentroid[axis] ) * normal[axis] / normalLength;
+            clusters.push_back( { start, end, sortKey } );
+        }
+
+        std::stable_sort( clusters.begin(), clusters.end(), []( const Cluster& a, const Cluster& b ) { return a.sortKey > b.sortKey; } );
+
+        std::vector<unsigned int> output;
+        output.reserve( indices.size() );
+        for ( const Cluster& cluster : clusters )
+            output.insert( output.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3 );
+        indices.swap( output );
+    }
+
+
+    // Renumbers vertices in order of first use so the vertex fetch walks memory forwards,
+    // and drops vertices no triangle uses. vertices holds vertexCount entries of stride
+    // bytes and is rewritten in place. Returns the new vertex count.
+    static size_t OptimizeVertexFetch( std::vector<unsigned int>& indices, void* vertices, size_t vertexCount, size_t stride )
+    {
+        const unsigned int unused = 0xFFFFFFFF;
+        std::vector<unsigned int> remap( vertexCount, unused );
+        unsigned int next = 0;
+        for ( unsigned int& index : indices )
+        {
+            if ( remap[index] == unused )
+                remap[index] = next++;
+            index = remap[index];
+        }
+
+        std::vector<unsigned char> source( (unsigned char*) vertices, (unsigned char*) vertices + vertexCount * stride );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            if ( remap[v] != unused )
+                memcpy( (unsigned char*) vertices + remap[v] * stride, &source[v * stride], stride );
+        return next;
+    }
+
+
+    // Quadric error edge collapse (Garland and Heckbert 1997). Each collapse moves one end of
+    // an edge onto the other, so the result indexes the same vertices and can share their
+    // buffer with the full mesh. Vertices at the same position are welded first, keeping
+    // seams closed; the survivor's attributes win. Collapses that would flip a triangle are
+    // skipped, and open edges get extra planes so borders stay in place. Stops at
+    // targetIndexCount or before a collapse whose error exceeds targetError, in position
+    // units; resultError, when given, receives the largest error reached.
+    static std::vector<unsigned int> Simplify( const std::vector<unsigned int>& indices, const float* positions, size_t positionStride, size_t vertexCount,
+                                               size_t targetIndexCount, float targetError = FLT_MAX, float* resultError = nullptr )
+    {
+        auto position = [&]( unsigned int v ) { return positions + v * positionStride; };
+
+        // Weld by position: every vertex maps to the first of its position in sorted order.
+        std::vector<unsigned int> byPosition( vertexCount );
+        for ( size_t v = 0; v < vertexCount; v++ )
+            byPosition[v] = (unsigned int) v;
+        std::sort( byPosition.begin(), byPosition.end(), [&]( unsigned int a, unsigned int b ) {
+            return std::lexicographical_compare( position( a ), position( a ) + 3, position( b ), position( b ) + 3 ) || ( !std::lexicographical_compare( position( b ), position( b ) + 3, position( a ), position( a ) + 3 ) && a < b );
+        } );
+        std::vector<unsigned int> collapsed( vertexCount );
+        for ( size_t i = 0; i < vertexCount; i++ )
+        {
+            unsigned int v = byPosition[i];
+            bool same = i > 0 && std::equal( position( v ), position( v ) + 3, position( byPosition[i - 1] ) );
+            collapsed[v] = same ? collapsed[byPosition[i - 1]] : v;
+        }
+
+        std::vector<unsigned int> result;
+        result.reserve( indices.size() );
+        for ( size_t i = 0; i + 2 < indices.size(); i += 3 )
+        {
+            unsigned int a = collapsed[indices[i]], b = collapsed[indices[i + 1]], c = collapsed[indices[i + 2]];
+            if ( a != b && b != c && c != a )
+                result.insert( result.end(), { a, b, c } );
+        }
+
+        std::vector<Quadric> quadrics( vertexCount );
+        AddTriangleQuadrics( result, positions, positionStride, quadrics );
+
+        float largestError = 0.0f;
+        double errorLimit = (double) targetError * targetError;
+        std::vector<unsigned int> adjacencyStart, adjacency;
+        std::vector<bool> locked( vertexCount );
+        while ( result.size() > targetIndexCount )
+        {
+            // Triangles around each vertex, as of the start of the pass.
+            adjacencyStart.assign( vertexCount + 1, 0 );
+            for ( unsigned int index : result )
+                adjacencyStart[index + 1]++;
+            for ( size_t v = 0; v < vertexCount; v++ )
+                adjacencyStart[v + 1] += adjacencyStart[v];
+            adjacency.resize( result.size() );
+            std::vector<unsigned int> fill( adjacencyStart.begin(), adjacencyStart.end() - 1 );
+            for ( size_t i = 0; i < result.size(); i++ )
+                adjacency[fill[result[i]]++] = (unsigned int) ( i / 3 );
+
+            // Every edge once, collapsing whichever way costs less.
+            std::vector<Collapse> collapses;
+            collapses.reserve( result.size() );
+            for ( size_t i = 0; i < result.size(); i++ )
+            {
+                unsigned int a = result[i];
+                unsigned int b = result[i - i % 3 + ( i + 1 ) % 3];
+                if ( a > b && HasEdge( result, adjacency, adjacencyStart, b, a ) )
+                    continue;
+                Quadric sum = quadrics[a];
+                sum.Add( quadrics[b] );
+                double toB = sum.Error( position( b ) );
+                double toA = sum.Error( position( a ) );
+                if ( toB <= toA )
+                    collapses.push_back( { toB, a, b } );
+                else
+                    collapses.push_back( { toA, b, a } );
+            }
+            std::sort( collapses.begin(), collapses.end(), []( const Collapse& x, const Collapse& y ) {
+                return x.error < y.error || ( x.error == y.error && ( x.from < y.from || ( x.from == y.from && x.to < y.to ) ) );
+            } );
+
+            // Take the cheapest collapses whose neighbourhoods do not overlap, until the pass
+            // has removed enough triangles. Each collapse locks everything it touched.
+            std::fill( locked.begin(), locked.end(), false );
+            std::vector<unsigned int> target( vertexCount );
+            for ( size_t v = 0; v < vertexCount; v++ )
+                target[v] = (unsigned int) v;
+            size_t toRemove = ( result.size() - targetIndexCount + 2 ) / 3;
+            size_t removed = 0;
+            for ( const Collapse& collapse : collapses )
+            {
+                if ( removed >= toRemove || collapse.error > errorLimit )
+                    break;
+                if ( locked[collapse.from] || locked[collapse.to] || Flips( result, adjacency, adjacencyStart, collapse, positions, positionStride ) )
+                    continue;
+                target[collapse.from] = collapse.to;
+                quadrics[collapse.to].Add( quadrics[collapse.from] );
+                largestError = std::max( largestError, (float) std::sqrt( std::max( collapse.error, 0.0 ) ) );
+                for ( unsigned int k = adjacencyStart[collapse.from]; k < adjacencyStart[collapse.from + 1]; k++ )
+                {
+                    const unsigned int* triangle = &result[adjacency[k] * 3];
+                    bool degenerate = false;
+                    for ( int c = 0; c < 3; c++ )
+                    {
+                        locked[triangle[c]] = true;
+                        degenerate = degenerate || triangle[c] == collapse.to;
+                    }
+                    removed += degenerate;
+                }
+            }
+            if ( removed == 0 )
+                break;
+
+            size_t kept = 0;
+            for ( size_t i = 0; i < result.size(); i += 3 )
+            {
+                unsigned int a = target[result[i]], b = target[result[i + 1]], c = target[result[i + 2]];
+                if ( a == b || b == c || c == a )
+                    continue;
+                result[kept++] = a;
+                result[kept++] = b;
+                result[kept++] = c;
+            }
+            result.resize( kept );
+        }
+
+        if ( resultError )
+            *resultError = largestError;
+        return result;
+    }
+
+
+private:
+    // Sum of squared distances to a set of weighted planes, kept as the symmetric 4x4
+    // matrix of plane * plane^T; the weight turns the sum into an average.
+    struct Quadric
+    {
+        double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+        double weight = 0.0;
+
+
+        void AddPlane( double a, double b, double c, double d, double planeWeight )
+        {
+            a2 += planeWeight * a * a; ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+            b2 += planeWeight * b * b; bc += planeWeight * b * c; bd += planeWeight * b * d;
+            c2 += planeWeight * c * c; cd += planeWeight * c * d;
+            d2 += planeWeight * d * d;
+            weight += planeWeight;
+        }
+
+
+        void Add( const Quadric& other )
+        {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+
+        // Average squared distance from p to the planes.
+        double Error( const float* p ) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double sum = a2 * x * x + b2 * y * y + c2 * z * z + 2.0 * ( ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z ) + d2;
+            return weight > 0.0 ? std::max( sum, 0.0 ) / weight : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        double error;
+        unsigned int from;
+        unsigned int to;
+    };
+
+    // Open edges are held in place by a plane through them, perpendicular to their triangle,
+    // weighted this much more than the triangle's own plane.
+    static constexpr double BORDER_WEIGHT = 10.0;
+
+
+    // Area-weighted triangle planes on each corner, and border planes on each open edge.
+    static void AddTriangleQuadrics( const std::vector<unsigned int>& indices, const float* positions, size_t positionStride, std::vector<Quadric>& quadrics )
+    {
+        std::vector<std::pair<unsigned int, unsigned int>> edges;
+        edges.reserve( indices.size() );
+        for ( size_t i = 0; i < indices.size(); i++ )
+            edges.push_back( { indices[i], indices[i - i % 3 + ( i + 1 ) % 3] } );
+        std::vector<std::pair<unsigned int, unsigned int>> sortedEdges = edges;
+        std::sort( sortedEdges.begin(), sortedEdges.end() );
+
+        for ( size_t t = 0; t < indices.size(); t += 3 )
+        {
+            const float* p[3] = { positions + indices[t] * positionStride, positions + indices[t + 1] * positionStride, positions + indices[t + 2] * positionStride };
+            double normal[3];
+            TriangleNormal( p, normal );
+            double length = std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+            if ( length <= 0.0 )
+                continue;
+            for ( int axis = 0; axis < 3; axis++ )
+                normal[axis] /= length;
+            double d = -( normal[0] * p[0][0] + normal[1] * p[0][1] + normal[2] * p[0][2] );
+            for ( int c = 0; c < 3; c++ )
+                quadrics[indices[t + c]].AddPlane( normal[0], normal[1], normal[2], d, length * 0.5 );
+
+            for ( int c = 0; c < 3; c++ )
+            {
+                const std::pair<unsigned int, unsigned int>& edge = edges[t + c];
+                if ( std::binary_search( sortedEdges.begin(), sortedEdges.end(), std::make_pair( edge.second, edge.first ) ) )
+                    continue;
+                const float* from = p[c];
+                const float* to = p[( c + 1 ) % 3];
+                double direction[3] = { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+                double border[3] = { direction[1] * normal[2] - direction[2] * normal[1], direction[2] * normal[0] - direction[0] * normal[2],
+                                     direction[0] * normal[1] - direction[1] * normal[0] };
+                double borderLength = std::sqrt( border[0] * border[0] + border[1] * border[1] + border[2] * border[2] );
+                if ( borderLength <= 0.0 )
+                    continue;
+                for ( int axis = 0; axis < 3; axis++ )
+                    border[axis] /= borderLength;
+                double borderD = -( border[0] * from[0] + border[1] * from[1] + border[2] * from[2] );
+                // borderLength is the edge length, as the normal is a unit vector.
+                double weight = BORDER_WEIGHT * borderLength * borderLength;
+                quadrics[edge.first].AddPlane( border[0], border[1], border[2], borderD, weight );
+                quadrics[edge.second].AddPlane( border[0], border[1], border[2], borderD, weight );
+            }
+        }
+    }
+
+
+    // Whether a triangle around a already uses the edge a-b.
+    static bool HasEdge( const std::vector<unsigned int>& indices, const std::vector<unsigned int>& adjacency, const std::vector<unsigned int>& adjacencyStart,
+                         unsigned int a, unsigned int b )
+    {
+        for ( unsigned int k = adjacencyStart[a]; k < adjacencyStart[a + 1]; k++ )
+        {
+            const unsigned int* triangle = &indices[adjacency[k] * 3];
+            for ( int c = 0; c < 3; c++ )
+                if ( triangle[c] == a && triangle[( c + 1 ) % 3] == b )
+                    return true;
+        }
+        return false;
+    }
+
+
+    // Whether moving collapse.from onto collapse.to turns any surviving triangle over.
+    static bool Flips( const std::vector<unsigned int>& indices, const std::vector<unsigned int>& adjacency, const std::vector<unsigned int>& adjacencyStart,
+                       const Collapse& collapse, const float* positions, size_t positionStride )
+    {
+        for ( unsigned int k = adjacencyStart[collapse.from]; k < adjacencyStart[collapse.from + 1]; k++ )
+        {
+            const unsigned int* triangle = &indices[adjacency[k] * 3];
+            if ( triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to )
+                continue;
+            const float* before[3];
+            const float* after[3];
+            for ( int c = 0; c < 3; c++ )
+            {
+                before[c] = positions + triangle[c] * positionStride;
+                after[c] = triangle[c] == collapse.from ? positions + collapse.to * positionStride : before[c];
+            }
+            double normalBefore[3], normalAfter[3];
+            TriangleNormal( before, normalBefore );
+            TriangleNormal( after, normalAfter );
+            // Turning further than about 75 degrees counts too; it folds thin triangles on edge.
+            double dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+            double lengths = std::sqrt( ( normalBefore[0] * normalBefore[0] + normalBefore[1] * normalBefore[1] + normalBefore[2] * normalBefore[2] ) *
+                                        ( normalAfter[0] * normalAfter[0] + normalAfter[1] * normalAfter[1] + normalAfter[2] * normalAfter[2] ) );
+            if ( dot <= 0.25 * lengths )
+                return true;
+        }
+        return false;
+    }
+
+
+    static void TriangleNormal( const float* const* p, double* normal )
+    {
+        double u[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+        double v[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+        normal[0] = u[1] * v[2] - u[2] * v[1];
+        normal[1] = u[2] * v[0] - u[0] * v[2];
+        normal[2] = u[0] * v[1] - u[1] * v[0];
+    }
+
+
+    static float ForsythScore( int cachePosition, unsigned int remainingTriangles, int lruSize )
+    {
+        if ( remainingTriangles == 0 )
+            return -1.0f;
+
+        float score = 0.0f;
+        if ( cachePosition >= 0 )
+        {
+            // The last triangle's three vertices score the same so strips are not favoured.
+            if ( cachePosition < 3 )
+                score = 0.75f;
+            else
+                score = std::pow( 1.0f - ( cachePosition - 3 ) / (float) ( lruSize - 3 ), 1.5f );
+        }
+        // Finish off vertices with few triangles left, so they leave the working set.
+        return score + 2.0f / std::sqrt( (float) remainingTriangles );
+    }
+
+
+    // Triangle indices where a cluster starts.
+    static std::vector<size_t> FindClusters( const std::vector<unsigned int>& indices, size_t vertexCount, float threshold )
+    {
+        size_t triangleCount = indices.size() / 3;
+        double targetAcmr = AnalyzeVertexCache( indices, vertexCount ).acmr * threshold;
+
+        // Hard boundaries: triangles that miss on all three vertices start a new strip of work.
+        std::vector<size_t> loadedAt( vertexCount, 0 );
+        std::vector<bool> seen( vertexCount, false );
+        size_t misses = 0;
+        std::vector<size_t> hard;
+        for ( size_t t = 0; t < triangleCount; t++ )
+        {
+            int triangleMisses = 0;
+            for ( int c = 0; c < 3; c++ )
+            {
+                unsigned int index = indices[t * 3 + c];
+                if ( seen[index] && misses - loadedAt[index] < (size_t) CACHE_SIZE )
+                    continue;
+                seen[index] = true;
+                loadedAt[index] = misses++;
+                triangleMisses++;
+            }
+            if ( t == 0 || triangleMisses == 3 )
+                hard.push_back( t );
+        }
+
+        // Soft boundaries: inside a hard cluster, cut wherever the cluster so far already
+        // runs at the target ACMR, since starting over there costs little.
+        std::vector<size_t> starts;
+        for ( size_t h = 0; h < hard.size(); h++ )
+        {
+            size_t start = hard[h];
+            size_t end = h + 1 < hard.size() ? hard[h + 1] : triangleCount;
+            starts.push_back( start );
+
+            std::fill( seen.begin(), seen.end(), false );
+            size_t clusterMisses = 0;
+            size_t clusterStart = start;
+            for ( size_t t = start; t < end; t++ )
+            {
+                for ( int c = 0; c < 3; c++ )
+                {
+                    unsigned int index = indices[t * 3 + c];
+                    if ( seen[index] && clusterMisses - loadedAt[index] < (size_t) CACHE_SIZE )
+                        continue;
+                    seen[index] = true;
+                    loadedAt[index] = clusterMisses++;
+                }
+                size_t clusterTriangles = t + 1 - clusterStart;
+                if ( t + 1 < end && clusterTriangles >= 32 && (double) clusterMisses / clusterTriangles <= targetAcmr )
+                {
+                    starts.push_back( t + 1 );
+                    clusterStart = t + 1;
+                    clusterMisses = 0;
+                    std::fill( seen.begin(), seen.end(), false );
+                }
+            }
+        }
+        return starts;
+    }
+};
+
+#endif
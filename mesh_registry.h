@@ -0,0 +1,457 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "gl_state_cache.h"
+#include "vertex_layout.h"
+
+
+// One level of detail: a range of the mesh's indices drawing a coarser version of it over
+// the same vertices.
+struct MeshLod
+{
+    // Counted from the mesh's firstIndex, in indexType units.
+    int indexOffset = 0;
+    int indexCount = 0;
+    // How far this level may stray from the full mesh, in model units.
+    float error = 0.0f;
+};
+
+
+// Where a registered mesh lives; everything a draw needs besides the program.
+struct Mesh
+{
+    static const int MAX_LODS = 8;
+
+    unsigned int vao = 0;
+    int format = -1;
+    int baseVertex = 0;
+    int vertexCount = 0;
+    // Counted in indexType units, like the offsets glDrawElements takes.
+    int firstIndex = 0;
+    int indexCount = 0;
+    // GL_UNSIGNED_SHORT whenever the mesh has at most 65536 vertices.
+    unsigned int indexType = GL_UNSIGNED_INT;
+    // Finest first; lods[0] is firstIndex and indexCount above. The levels' indices follow
+    // each other in one allocation.
+    int lodCount = 1;
+    MeshLod lods[MAX_LODS];
+};
+
+
+// Suballocates static geometry out of one shared vertex buffer and one shared index
+// buffer per vertex format, each pair behind a single VAO, so meshes of the same format
+// draw back to back without rebinding anything. Indices are stored relative to the
+// mesh's first vertex and drawn with glDrawElementsBaseVertex, which lets any mesh of up
+// to 65536 vertices use 16-bit indices. The index buffer is handed out in 4-byte slots
+// holding one 32-bit or two 16-bit indices, so both kinds share a pool and a VAO.
+//
+// Freed ranges go back to a sorted free-list and merge with their neighbours. A pool
+// that runs out of room grows, and Defragment() packs the live meshes to the front.
+// Both keep the GL buffer names, so VAOs and anything else pointing at a pool stay valid.
+class MeshRegistry
+{
+public:
+    // Returns the pool for this format, creating it on first use. initialIndices counts
+    // 32-bit indices; twice as many 16-bit ones fit.
+    int RegisterFormat( const VertexFormat& format, int initialVertices = 65536, int initialIndices = 3 * 65536 )
+    {
+        for ( size_t i = 0; i < pools.size(); i++ )
+            if ( pools[i].format == format )
+                return (int) i;
+
+        Pool pool;
+        pool.format = format;
+        pool.stride = format.Stride();
+        pool.vertexCapacity = initialVertices;
+        pool.indexCapacity = initialIndices;
+        pool.freeVertices.push_back( { 0, pool.vertexCapacity } );
+        pool.freeIndices.push_back( { 0, pool.indexCapacity } );
+
+        glGenBuffers( 1, &pool.vbo );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, pool.vbo );
+        glBufferData( GL_COPY_WRITE_BUFFER, pool.vertexCapacity * pool.stride, NULL, GL_STATIC_DRAW );
+        glGenBuffers( 1, &pool.ebo );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, pool.ebo );
+        glBufferData( GL_COPY_WRITE_BUFFER, pool.indexCapacity * SLOT_SIZE, NULL, GL_STATIC_DRAW );
+
+        glGenVertexArrays( 1, &pool.vao );
+        GLStateCache::BindVertexArray( pool.vao );
+        GLStateCache::BindBuffer( GL_ARRAY_BUFFER, pool.vbo );
+        GLStateCache::BindBuffer( GL_ELEMENT_ARRAY_BUFFER, pool.ebo );
+        format.PointAttributes( 0 );
+        GLStateCache::BindVertexArray( 0 );
+
+        pools.push_back( pool );
+        return (int) pools.size() - 1;
+    }
+
+
+    const VertexFormat& GetFormat( int format ) const
+    {
+        return pools[format].format;
+    }
+
+
+    // Copies the geometry, already in the format's layout, into the format's pool. Returns the mesh id, or -1 on bad input.
+    int Add( int format, const void* vertices, int vertexCount, const unsigned int* indices, int indexCount )
+    {
+        MeshLod lod;
+        lod.indexCount = indexCount;
+        return Add( format, vertices, vertexCount, indices, &lod, 1 );
+    }
+
+
+    // The same with levels of detail: indices holds every level's indices back to back, at
+    // the offsets lods gives, finest first, starting with the full mesh at offset 0.
+    int Add( int format, const void* vertices, int vertexCount, const unsigned int* indices, const MeshLod* lods, int lodCount )
+    {
+        if ( format < 0 || format >= (int) pools.size() || vertexCount <= 0 || lodCount <= 0 || lodCount > Mesh::MAX_LODS || lods[0].indexCount <= 0 )
+            return -1;
+        int indexCount = 0;
+        for ( int i = 0; i < lodCount; i++ )
+            indexCount = std::max( indexCount, lods[i].indexOffset + lods[i].indexCount );
+        Pool& pool = pools[format];
+        unsigned int indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        size_t indexSlots = IndexSlots( indexType, indexCount );
+
+        size_t baseVertex = Allocate( pool.freeVertices, vertexCount );
+        if ( baseVertex == NONE )
+        {
+            GrowVertices( pool, vertexCount );
+            baseVertex = Allocate( pool.freeVertices, vertexCount );
+        }
+        size_t firstSlot = Allocate( pool.freeIndices, indexSlots );
+        if ( firstSlot == NONE )
+        {
+            GrowIndices( pool, indexSlots );
+            firstSlot = Allocate( pool.freeIndices, indexSlots );
+        }
+
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, pool.vbo );
+        glBufferSubData( GL_COPY_WRITE_BUFFER, baseVertex * pool.stride, vertexCount * pool.stride, vertices );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, pool.ebo );
+        if ( indexType == GL_UNSIGNED_SHORT )
+        {
+            std::vector<uint16_t> shortIndices( indices, indices + indexCount );
+            glBufferSubData( GL_COPY_WRITE_BUFFER, firstSlot * SLOT_SIZE, indexCount * sizeof( uint16_t ), shortIndices.data() );
+        }
+        else
+            glBufferSubData( GL_COPY_WRITE_BUFFER, firstSlot * SLOT_SIZE, indexCount * sizeof( unsigned int ), indices );
+
+        Mesh mesh;
+        mesh.vao = pool.vao;
+        mesh.format = format;
+        mesh.baseVertex = (int) baseVertex;
+        mesh.vertexCount = vertexCount;
+        mesh.firstIndex = (int) ( firstSlot * SLOT_SIZE / IndexSize( indexType ) );
+        mesh.indexCount = lods[0].indexCount;
+        mesh.indexType = indexType;
+        mesh.lodCount = lodCount;
+        std::copy( lods, lods + lodCount, mesh.lods );
+
+        if ( freeIds.empty() )
+        {
+            meshes.push_back( mesh );
+            alive.push_back( true );
+            return (int) meshes.size() - 1;
+        }
+        int id = freeIds.back();
+        freeIds.pop_back();
+        meshes[id] = mesh;
+        alive[id] = true;
+        return id;
+    }
+
+
+    void Remove( int id )
+    {
+        if ( !IsValid( id ) )
+            return;
+        Mesh& mesh = meshes[id];
+        Pool& pool = pools[mesh.format];
+        Release( pool.freeVertices, mesh.baseVertex, mesh.vertexCount );
+        Release( pool.freeIndices, FirstSlot( mesh ), IndexSlots( mesh.indexType, TotalIndexCount( mesh ) ) );
+        alive[id] = false;
+        freeIds.push_back( id );
+    }
+
+
+    bool IsValid( int id ) const
+    {
+        return id >= 0 && id < (int) meshes.size() && alive[id];
+    }
+
+
+    // Only valid until the next Add(), Remove() or Defragment().
+    const Mesh& Get( int id ) const
+    {
+        return meshes[id];
+    }
+
+
+    unsigned int GetVertexBuffer( int format ) const
+    {
+        return pools[format].vbo;
+    }
+
+
+    unsigned int GetIndexBuffer( int format ) const
+    {
+        return pools[format].ebo;
+    }
+
+
+    // Free ranges across all pools; more than one per pool means there are holes.
+    int GetFreeRangeCount() const
+    {
+        int count = 0;
+        for ( const Pool& pool : pools )
+            count += (int) ( pool.freeVertices.size() + pool.freeIndices.size() );
+        return count;
+    }
+
+
+    int GetMeshCount() const
+    {
+        return (int) ( meshes.size() - freeIds.size() );
+    }
+
+
+    // Moves every live mesh to the front of its pool, leaving a single free range at the end.
+    // Mesh ids stay the same; their offsets change.
+    void Defragment()
+    {
+        for ( size_t format = 0; format < pools.size(); format++ )
+        {
+            Pool& pool = pools[format];
+            std::vector<int> byVertex;
+            std::vector<int> byIndex;
+            for ( size_t id = 0; id < meshes.size(); id++ )
+                if ( alive[id] && meshes[id].format == (int) format )
+                {
+                    byVertex.push_back( (int) id );
+                    byIndex.push_back( (int) id );
+                }
+            std::sort( byVertex.begin(), byVertex.end(), [this]( int a, int b ) { return meshes[a].baseVertex < meshes[b].baseVertex; } );
+            std::sort( byIndex.begin(), byIndex.end(), [this]( int a, int b ) { return FirstSlot( meshes[a] ) < FirstSlot( meshes[b] ); } );
+
+            std::vector<CopyRange> vertexCopies;
+            size_t vertexEnd = 0;
+            for ( int id : byVertex )
+            {
+                Mesh& mesh = meshes[id];
+                vertexCopies.push_back( { mesh.baseVertex * pool.stride, vertexEnd * pool.stride, mesh.vertexCount * pool.stride } );
+                mesh.baseVertex = (int) vertexEnd;
+                vertexEnd += mesh.vertexCount;
+            }
+            std::vector<CopyRange> indexCopies;
+            size_t indexEnd = 0;
+            for ( int id : byIndex )
+            {
+                Mesh& mesh = meshes[id];
+                size_t slots = IndexSlots( mesh.indexType, TotalIndexCount( mesh ) );
+                indexCopies.push_back( { FirstSlot( mesh ) * SLOT_SIZE, indexEnd * SLOT_SIZE, slots * SLOT_SIZE } );
+                mesh.firstIndex = (int) ( indexEnd * SLOT_SIZE / IndexSize( mesh.indexType ) );
+                indexEnd += slots;
+            }
+
+            Repack( pool.vbo, pool.vertexCapacity * pool.stride, vertexCopies );
+            Repack( pool.ebo, pool.indexCapacity * SLOT_SIZE, indexCopies );
+            pool.freeVertices.assign( 1, { vertexEnd, pool.vertexCapacity - vertexEnd } );
+            pool.freeIndices.assign( 1, { indexEnd, pool.indexCapacity - indexEnd } );
+            if ( vertexEnd == pool.vertexCapacity )
+                pool.freeVertices.clear();
+            if ( indexEnd == pool.indexCapacity )
+                pool.freeIndices.clear();
+        }
+    }
+
+
+    void Unload()
+    {
+        for ( Pool& pool : pools )
+        {
+            GLStateCache::DeleteVertexArray( pool.vao );
+            GLStateCache::DeleteBuffer( pool.vbo );
+            GLStateCache::DeleteBuffer( pool.ebo );
+        }
+        pools.clear();
+        meshes.clear();
+        alive.clear();
+        freeIds.clear();
+    }
+
+
+private:
+    static const size_t NONE = (size_t) -1;
+    // Unit of the index free-lists, in bytes.
+    static const size_t SLOT_SIZE = 4;
+
+    struct FreeRange
+    {
+        size_t start;
+        size_t count;
+    };
+
+    struct CopyRange
+    {
+        size_t from;
+        size_t to;
+        size_t size;
+    };
+
+    struct Pool
+    {
+        VertexFormat format;
+        size_t stride = 0;
+        unsigned int vao = 0;
+        unsigned int vbo = 0;
+        unsigned int ebo = 0;
+        size_t vertexCapacity = 0;
+        // In slots, like freeIndices.
+        size_t indexCapacity = 0;
+        // Sorted by start, never adjacent to each other.
+        std::vector<FreeRange> freeVertices;
+        std::vector<FreeRange> freeIndices;
+    };
+
+    std::vector<Pool> pools;
+    std::vector<Mesh> meshes;
+    std::vector<bool> alive;
+    std::vector<int> freeIds;
+
+
+    static size_t IndexSize( unsigned int indexType )
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof( uint16_t ) : sizeof( unsigned int );
+    }
+
+
+    static size_t IndexSlots( unsigned int indexType, size_t indexCount )
+    {
+        return ( indexCount * IndexSize( indexType ) + SLOT_SIZE - 1 ) / SLOT_SIZE;
+    }
+
+
+    // Indices of every level together.
+    static size_t TotalIndexCount( const Mesh& mesh )
+    {
+        int count = 0;
+        for ( int i = 0; i < mesh.lodCount; i++ )
+            count = std::max( count, mesh.lods[i].indexOffset + mesh.lods[i].indexCount );
+        return count;
+    }
+
+
+    static size_t FirstSlot( const Mesh& mesh )
+    {
+        return mesh.firstIndex * IndexSize( mesh.indexType ) / SLOT_SIZE;
+    }
+
+
+    // First fit.
+    static size_t Allocate( std::vector<FreeRange>& freeList, size_t count )
+    {
+        for ( size_t i = 0; i < freeList.size(); i++ )
+        {
+            FreeRange& range = freeList[i];
+            if ( range.count < count )
+                continue;
+            size_t start = range.start;
+            range.start += count;
+            range.count -= count;
+            if ( range.count == 0 )
+                freeList.erase( freeList.begin() + i );
+            return start;
+        }
+        return NONE;
+    }
+
+
+    static void Release( std::vector<FreeRange>& freeList, size_t start, size_t count )
+    {
+        auto next = std::lower_bound( freeList.begin(), freeList.end(), start,
+                                      []( const FreeRange& range, size_t value ) { return range.start < value; } );
+        next = freeList.insert( next, { start, count } );
+
+        auto following = next + 1;
+        if ( following != freeList.end() && next->start + next->count == following->start )
+        {
+            next->count += following->count;
+            freeList.erase( following );
+        }
+        if ( next != freeList.begin() )
+        {
+            auto previous = next - 1;
+            if ( previous->start + previous->count == next->start )
+            {
+                previous->count += next->count;
+                freeList.erase( next );
+            }
+        }
+    }
+
+
+    void GrowVertices( Pool& pool, size_t needed )
+    {
+        size_t capacity = std::max( pool.vertexCapacity * 2, pool.vertexCapacity + needed );
+        Resize( pool.vbo, pool.vertexCapacity * pool.stride, capacity * pool.stride );
+        Release( pool.freeVertices, pool.vertexCapacity, capacity - pool.vertexCapacity );
+        pool.vertexCapacity = capacity;
+    }
+
+
+    void GrowIndices( Pool& pool, size_t needed )
+    {
+        size_t capacity = std::max( pool.indexCapacity * 2, pool.indexCapacity + needed );
+        Resize( pool.ebo, pool.indexCapacity * SLOT_SIZE, capacity * SLOT_SIZE );
+        Release( pool.freeIndices, pool.indexCapacity, capacity - pool.indexCapacity );
+        pool.indexCapacity = capacity;
+    }
+
+
+    // Reallocates buffer in place through a scratch copy, keeping its name and contents.
+    static void Resize( unsigned int buffer, size_t oldSize, size_t newSize )
+    {
+        unsigned int scratch = CopyToScratch( buffer, oldSize );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+        glBufferData( GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW );
+        GLStateCache::BindBuffer( GL_COPY_READ_BUFFER, scratch );
+        glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize );
+        GLStateCache::DeleteBuffer( scratch );
+    }
+
+
+    // Copy ranges may overlap inside one buffer, so they go through a scratch buffer.
+    static void Repack( unsigned int buffer, size_t size, const std::vector<CopyRange>& copies )
+    {
+        if ( copies.empty() )
+            return;
+        unsigned int scratch = CopyToScratch( buffer, size );
+        GLStateCache::BindBuffer( GL_COPY_READ_BUFFER, scratch );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, buffer );
+        for ( const CopyRange& copy : copies )
+            if ( copy.from != copy.to )
+                glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, copy.from, copy.to, copy.size );
+        GLStateCache::DeleteBuffer( scratch );
+    }
+
+
+    static unsigned int CopyToScratch( unsigned int buffer, size_t size )
+    {
+        unsigned int scratch = 0;
+        glGenBuffers( 1, &scratch );
+        GLStateCache::BindBuffer( GL_COPY_WRITE_BUFFER, scratch );
+        glBufferData( GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_COPY );
+        GLStateCache::BindBuffer( GL_COPY_READ_BUFFER, buffer );
+        glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, size );
+        return scratch;
+    }
+};
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "bvh.h"
+#include "frustum_culler.h"
+
+
+// Software occlusion culling: a few large occluder meshes are rasterized into a small CPU
+// depth buffer each frame, a max-depth pyramid is built over it, and object bounds are
+// tested against the pyramid level where they cover only a few texels. An object is hidden
+// when its nearest point is behind the farthest occluder depth everywhere it could appear.
+//
+// Occluders cover pixel centers the way GL does, so triangles sharing an edge leave no gaps,
+// and write the farthest depth within a pixel of the center. Objects are tested with the
+// nearest depth of their box over every pixel center less than a pixel outside its screen
+// rectangle; those centers surround every point of the box, so an object that shows past
+// the edge of a convex occluder always stays visible. Only gaps between occluders narrower
+// than a pixel may be treated as closed. Depth follows GL: window z in [0, 1], smaller is nearer.
+//
+//   culler.BeginFrame();
+//   culler.AddOccluder( positions, 3, vertexCount, indices, indexCount, viewProjection );
+//   culler.Rasterize();
+//   if ( culler.IsVisible( box, viewProjection ) ) ...
+class OcclusionCuller
+{
+public:
+    // Depth buffer size; the width must be a multiple of TILE_WIDTH, the height of TILE_HEIGHT.
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 16;
+
+    // Rasterize 4 pixels per instruction where SSE is available.
+    bool useSimd = true;
+
+    // Totals since Init().
+    long long trianglesRasterized = 0;
+    long long objectsTested = 0;
+    long long objectsOccluded = 0;
+
+
+    void Init( int width = 256, int height = 128 )
+    {
+        this->width = std::max( ( width + TILE_WIDTH - 1 ) / TILE_WIDTH, 1 ) * TILE_WIDTH;
+        this->height = std::max( ( height + TILE_HEIGHT - 1 ) / TILE_HEIGHT, 1 ) * TILE_HEIGHT;
+        tilesX = this->width / TILE_WIDTH;
+        tilesY = this->height / TILE_HEIGHT;
+        bins.assign( tilesX * tilesY, std::vector<int>() );
+
+        levels.clear();
+        int levelWidth = this->width;
+        int levelHeight = this->height;
+        while ( true )
+        {
+            levels.push_back( { levelWidth, levelHeight, std::vector<float>( levelWidth * levelHeight, 1.0f ) } );
+            if ( levelWidth == 1 && levelHeight == 1 )
+                break;
+            levelWidth = std::max( levelWidth / 2, 1 );
+            levelHeight = std::max( levelHeight / 2, 1 );
+        }
+        trianglesRasterized = objectsTested = objectsOccluded = 0;
+    }
+
+
+    int GetWidth() const
+    {
+        return width;
+    }
+
+
+    int GetHeight() const
+    {
+        return height;
+    }
+
+
+    void BeginFrame()
+    {
+        triangles.clear();
+        for ( std::vector<int>& bin : bins )
+            bin.clear();
+    }
+
+
+    // Transforms an occluder to screen space and bins its triangles by tile. positions holds
+    // x, y, z every stride floats; matrix is the column-major model-view-projection. Triangles
+    // reaching behind the camera are dropped, which only makes the occluder smaller.
+    void AddOccluder( const float* positions, int stride, int vertexCount, const unsigned int* indices, int indexCount, const float* matrix )
+    {
+        screen.resize( vertexCount );
+        for ( int v = 0; v < vertexCount; v++ )
+        {
+            const float* p = positions + v * stride;
+            float clip[4];
+            for ( int row = 0; row < 4; row++ )
+                clip[row] = matrix[row] * p[0] + matrix[4 + row] * p[1] + matrix[8 + row] * p[2] + matrix[12 + row];
+            ScreenVertex& out = screen[v];
+            out.valid = clip[3] > 1e-6f;
+            if ( !out.valid )
+                continue;
+            float inverseW = 1.0f / clip[3];
+            out.x = ( clip[0] * inverseW * 0.5f + 0.5f ) * width;
+            out.y = ( clip[1] * inverseW * 0.5f + 0.5f ) * height;
+            out.z = clip[2] * inverseW * 0.5f + 0.5f;
+        }
+
+        for ( int i = 0; i + 2 < indexCount; i += 3 )
+        {
+            const ScreenVertex& a = screen[indices[i]];
+            const ScreenVertex& b = screen[indices[i + 1]];
+            const ScreenVertex& c = screen[indices[i + 2]];
+            if ( !a.valid || !b.valid || !c.valid )
+                continue;
+            SetupTriangle( a, b, c );
+        }
+    }
+
+
+    // Fills the depth buffer from the binned triangles and rebuilds the pyramid.
+    void Rasterize()
+    {
+        std::vector<float>& depth = levels[0].depth;
+        std::fill( depth.begin(), depth.end(), 1.0f );
+        // Tiles touch disjoint pixels, so they could go to separate threads as they are.
+        for ( int tile = 0; tile < tilesX * tilesY; tile++ )
+            for ( int triangle : bins[tile] )
+                RasterizeInTile( triangles[triangle], tile % tilesX, tile / tilesX );
+        trianglesRasterized += triangles.size();
+        BuildPyramid();
+    }
+
+
+    // Whether any part of box may be in front of the occluders. Boxes reaching behind the
+    // camera or entirely off screen count as visible; frustum culling is a separate step.
+    bool IsVisible( const Aabb& box, const float* matrix )
+    {
+        objectsTested++;
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+        for ( int corner = 0; corner < 8; corner++ )
+        {
+            float p[3] = { corner & 1 ? box.max[0] : box.min[0], corner & 2 ? box.max[1] : box.min[1], corner & 4 ? box.max[2] : box.min[2] };
+            float clip[4];
+            for ( int row = 0; row < 4; row++ )
+                clip[row] = matrix[row] * p[0] + matrix[4 + row] * p[1] + matrix[8 + row] * p[2] + matrix[12 + row];
+            if ( clip[3] <= 1e-6f )
+                return true;
+            float inverseW = 1.0f / clip[3];
+            float x = ( clip[0] * inverseW * 0.5f + 0.5f ) * width;
+            float y = ( clip[1] * inverseW * 0.5f + 0.5f ) * height;
+            minX = std::min( minX, x );
+            maxX = std::max( maxX, x );
+            minY = std::min( minY, y );
+            maxY = std::max( maxY, y );
+            nearest = std::min( nearest, clip[2] * inverseW * 0.5f + 0.5f );
+        }
+        if ( maxX <= 0.0f || maxY <= 0.0f || minX >= width || minY >= height || nearest <= 0.0f )
+            return true;
+
+        // The on-screen pixels whose centers surround the rectangle, then the level where they
+        // are at most 2x2 texels.
+        int x0 = std::max( (int) std::floor( minX - 0.5f ), 0 );
+        int y0 = std::max( (int) std::floor( minY - 0.5f ), 0 );
+        int x1 = std::min( (int) std::floor( maxX + 0.5f ), width - 1 );
+        int y1 = std::min( (int) std::floor( maxY + 0.5f ), height - 1 );
+        int level = 0;
+        while ( level + 1 < (int) levels.size() && ( ( x1 >> level ) - ( x0 >> level ) > 1 || ( y1 >> level ) - ( y0 >> level ) > 1 ) )
+            level++;
+
+        const Level& pyramid = levels[level];
+        int tx1 = std::min( x1 >> level, pyramid.width - 1 );
+        int ty1 = std::min( y1 >> level, pyramid.height - 1 );
+        for ( int ty = y0 >> level; ty <= ty1; ty++ )
+            for ( int tx = x0 >> level; tx <= tx1; tx++ )
+                if ( nearest <= pyramid.depth[ty * pyramid.width + tx] )
+                    return true;
+        objectsOccluded++;
+        return false;
+    }
+
+
+    // Keeps the candidates whose bounding spheres may be visible, preserving their order.
+    // Returns how many were written to out, which may alias candidates.
+    int Filter( const BoundsStore& bounds, const uint32_t* candidates, int count, const float* matrix, uint32_t* out )
+    {
+        int kept = 0;
+        for ( int i = 0; i < count; i++ )
+        {
+            uint32_t object = candidates[i];
+            Aabb box = Aabb::FromSphere( bounds.x[object], bounds.y[object], bounds.z[object], bounds.radius[object] );
+            if ( IsVisible( box, matrix ) )
+                out[kept++] = object;
+        }
+        return kept;
+    }
+
+
+    // Depth at a pixel of the full-resolution buffer, for debugging.
+    float GetDepth( int x, int y ) const
+    {
+        return levels[0].depth[y * width + x];
+    }
+
+
+private:
+    struct ScreenVertex
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        bool valid = false;
+    };
+
+    // Edge functions e = a * x + b * y + c, positive inside, and the depth plane with the
+    // conservative offset baked in; evaluated at pixel centers.
+    struct Triangle
+    {
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        float depthA;
+        float depthB;
+        float depthC;
+        float maxDepth;
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    struct Level
+    {
+        int width;
+        int height;
+        // Farthest depth of the texels below; level 0 is the depth buffer itself.
+        std::vector<float> depth;
+    };
+
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<Level> levels;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<int>> bins;
+    std::vector<ScreenVertex> screen;
+
+
+    void SetupTriangle( const ScreenVertex& a, ScreenVertex b, ScreenVertex c )
+    {
+        float area = ( b.x - a.x ) * ( c.y - a.y ) - ( b.y - a.y ) * ( c.x - a.x );
+        if ( std::fabs( area ) < 1e-8f )
+            return;
+        // Occluders are double-sided; make the winding counter-clockwise.
+        if ( area < 0.0f )
+        {
+            std::swap( b, c );
+            area = -area;
+        }
+
+        Triangle triangle;
+        const ScreenVertex* v[3] = { &a, &b, &c };
+        for ( int edge = 0; edge < 3; edge++ )
+        {
+            const ScreenVertex& from = *v[edge];
+            const ScreenVertex& to = *v[( edge + 1 ) % 3];
+            // Centers exactly on an edge count for both triangles sharing it.
+            triangle.edgeA[edge] = from.y - to.y;
+            triangle.edgeB[edge] = to.x - from.x;
+            triangle.edgeC[edge] = from.x * to.y - from.y * to.x;
+        }
+
+        // Depth plane through the three vertices, pushed back to its farthest value within a
+        // pixel of the center, which covers every point an object test can attribute to it.
+        float dzdx = ( ( b.z - a.z ) * ( c.y - a.y ) - ( c.z - a.z ) * ( b.y - a.y ) ) / area;
+        float dzdy = ( ( c.z - a.z ) * ( b.x - a.x ) - ( b.z - a.z ) * ( c.x - a.x ) ) / area;
+        triangle.depthA = dzdx;
+        triangle.depthB = dzdy;
+        triangle.depthC = a.z - dzdx * a.x - dzdy * a.y + std::fabs( dzdx ) + std::fabs( dzdy );
+        triangle.maxDepth = std::max( a.z, std::max( b.z, c.z ) );
+
+        triangle.minX = std::max( (int) std::floor( std::min( a.x, std::min( b.x, c.x ) ) ), 0 );
+        triangle.minY = std::max( (int) std::floor( std::min( a.y, std::min( b.y, c.y ) ) ), 0 );
+        triangle.maxX = std::min( (int) std::ceil( std::max( a.x, std::max( b.x, c.x ) ) ), width - 1 );
+        triangle.maxY = std::min( (int) std::ceil( std::max( a.y, std::max( b.y, c.y ) ) ), height - 1 );
+        if ( triangle.minX > triangle.maxX || triangle.minY > triangle.maxY || triangle.maxDepth < 0.0f )
+            return;
+
+        int index = (int) triangles.size();
+        triangles.push_back( triangle );
+        for ( int ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT; ty++ )
+            for ( int tx = triangle.minX / TILE_WIDTH; tx <= triangle.maxX / TILE_WIDTH; tx++ )
+                bins[ty * tilesX + tx].push_back( index );
+    }
+
+
+    void RasterizeInTile( const Triangle& triangle, int tileX, int tileY )
+    {
+        // Rows start on a multiple of 4 pixels so the SIMD path can use aligned groups.
+        int x0 = std::max( triangle.minX, tileX * TILE_WIDTH ) & ~3;
+        int x1 = std::min( triangle.maxX, ( tileX + 1 ) * TILE_WIDTH - 1 );
+        int y0 = std::max( triangle.minY, tileY * TILE_HEIGHT );
+        int y1 = std::min( triangle.maxY, ( tileY + 1 ) * TILE_HEIGHT - 1 );
+        float* depth = levels[0].depth.data();
+
+#ifdef BANANA_CULL_SIMD
+        if ( useSimd )
+        {
+            __m128 edgeA[3], edgeB[3], edgeC[3];
+            for ( int e = 0; e < 3; e++ )
+            {
+                edgeA[e] = _mm_set1_ps( triangle.edgeA[e] );
+                edgeB[e] = _mm_set1_ps( triangle.edgeB[e] );
+                edgeC[e] = _mm_set1_ps( triangle.edgeC[e] );
+            }
+            __m128 depthA = _mm_set1_ps( triangle.depthA );
+            __m128 depthB = _mm_set1_ps( triangle.depthB );
+            __m128 depthC = _mm_set1_ps( triangle.depthC );
+            __m128 maxDepth = _mm_set1_ps( triangle.maxDepth );
+            __m128 zero = _mm_setzero_ps();
+            const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+            for ( int y = y0; y <= y1; y++ )
+            {
+                __m128 py = _mm_set1_ps( y + 0.5f );
+                for ( int x = x0; x <= x1; x += 4 )
+                {
+                    __m128 px = _mm_add_ps( _mm_set1_ps( (float) x ), laneOffsets );
+                    __m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+                    for ( int e = 0; e < 3; e++ )
+                    {
+                        __m128 value = _mm_add_ps( _mm_add_ps( _mm_mul_ps( edgeA[e], px ), _mm_mul_ps( edgeB[e], py ) ), edgeC[e] );
+                        inside = _mm_and_ps( inside, _mm_cmpge_ps( value, zero ) );
+                    }
+                    if ( _mm_movemask_ps( inside ) == 0 )
+                        continue;
+                    __m128 z = _mm_add_ps( _mm_add_ps( _mm_mul_ps( depthA, px ), _mm_mul_ps( depthB, py ) ), depthC );
+                    z = _mm_min_ps( z, maxDepth );
+                    float* row = depth + y * width + x;
+                    __m128 old = _mm_loadu_ps( row );
+                    __m128 nearer = _mm_min_ps( old, z );
+                    _mm_storeu_ps( row, _mm_or_ps( _mm_and_ps( inside, nearer ), _mm_andnot_ps( inside, old ) ) );
+                }
+            }
+            return;
+        }
+#endif
+        for ( int y = y0; y <= y1; y++ )
+        {
+            float py = y + 0.5f;
+            for ( int x = x0; x <= x1; x++ )
+            {
+                float px = x + 0.5f;
+                bool inside = true;
+                for ( int e = 0; e < 3; e++ )
+                    inside = inside && ( triangle.edgeA[e] * px + triangle.edgeB[e] * py ) + triangle.edgeC[e] >= 0.0f;
+                if ( !inside )
+                    continue;
+                float z = std::min( ( triangle.depthA * px + triangle.depthB * py ) + triangle.depthC, triangle.maxDepth );
+                float& stored = depth[y * width + x];
+                stored = std::min( stored, z );
+            }
+        }
+    }
+
+
+    void BuildPyramid()
+    {
+        for ( size_t level = 1; level < levels.size(); level++ )
+        {
+            const Level& source = levels[level - 1];
+            Level& target = levels[level];
+            for ( int y = 0; y < target.height; y++ )
+                for ( int x = 0; x < target.width; x++ )
+                {
+                    // Odd sizes fold their last row or column into the last texel.
+                    int sx0 = x * 2;
+                    int sy0 = y * 2;
+                    int sx1 = x == target.width - 1 ? source.width - 1 : sx0 + 1;
+                    int sy1 = y == target.height - 1 ? source.height - 1 : sy0 + 1;
+                    float farthest = 0.0f;
+                    for ( int sy = sy0; sy <= sy1; sy++ )
+                        for ( int sx = sx0; sx <= sx1; sx++ )
+                            farthest = std::max( farthest, source.depth[sy * source.width + sx] );
+                    target.depth[y * target.width + x] = farthest;
+                }
+        }
+    }
+};
+
+#endif
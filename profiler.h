@@ -0,0 +1,412 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct ProfileStats
+{
+    // Slash-separated path from the root scope, e.g. "Frame/Render".
+    std::string path;
+    bool gpu = false;
+    size_t count = 0;
+    double minMs = 0.0;
+    double avgMs = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+
+// Frame profiler with nested CPU scopes and flat GPU scopes.
+// CPU scopes are timed with steady_clock and aggregated per position in the scope tree.
+// GPU scopes use GL_TIME_ELAPSED queries in two sets that alternate between frames; a
+// set is read back just before it is reused, two frames later, so reading rarely waits.
+// Scope names must be string literals (or otherwise outlive the profiler).
+// CPU scopes may be opened from several threads; each thread nests its own scopes and gets
+// its own trace track. GPU scopes belong to the thread that owns the GL context.
+class Profiler
+{
+public:
+    bool enabled = false;
+    // Keep raw events for WriteChromeTrace(); off by default to bound memory on long runs.
+    bool recordTrace = false;
+
+
+    void BeginFrame()
+    {
+        if ( !enabled )
+            return;
+        BeginGpuFrame();
+        BeginCpu( "Frame" );
+    }
+
+
+    // The GPU half of BeginFrame(), for a GL thread that does not own the frame scope.
+    void BeginGpuFrame()
+    {
+        if ( !enabled )
+            return;
+        frameIndex++;
+        CollectGpuResults( queries[frameIndex % 2] );
+    }
+
+
+    // Names the calling thread's track in the trace; unnamed threads show up as "CPU".
+    void NameThread( const char* name )
+    {
+        std::lock_guard<std::mutex> lock( mutex );
+        GetThread().name = name;
+    }
+
+
+    void EndFrame()
+    {
+        if ( !enabled )
+            return;
+        EndCpu();
+    }
+
+
+    void BeginCpu( const char* name )
+    {
+        if ( !enabled )
+            return;
+        std::lock_guard<std::mutex> lock( mutex );
+        std::vector<OpenScope>& openScopes = GetThread().openScopes;
+        int parent = openScopes.empty() ? -1 : openScopes.back().node;
+        openScopes.push_back( { FindOrAddNode( cpuNodes, parent, name ), Now() } );
+    }
+
+
+    void EndCpu()
+    {
+        if ( !enabled )
+            return;
+        std::lock_guard<std::mutex> lock( mutex );
+        ThreadScopes& thread = GetThread();
+        if ( thread.openScopes.empty() )
+            return;
+        OpenScope scope = thread.openScopes.back();
+        thread.openScopes.pop_back();
+        double end = Now();
+        cpuNodes[scope.node].samples.push_back( (float) ( ( end - scope.start ) / 1000.0 ) );
+        if ( recordTrace )
+            traceEvents.push_back( { cpuNodes[scope.node].name, scope.start, end - scope.start, thread.track } );
+    }
+
+
+    // GL allows only one GL_TIME_ELAPSED query at a time, so GPU scopes must not nest.
+    void BeginGpu( const char* name )
+    {
+        if ( !enabled )
+            return;
+        std::vector<GpuQuery>& set = queries[frameIndex % 2];
+        GpuQuery query;
+        if ( freeQueries.empty() )
+            glGenQueries( 1, &query.id );
+        else
+        {
+            query.id = freeQueries.back();
+            freeQueries.pop_back();
+        }
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            query.node = FindOrAddNode( gpuNodes, -1, name );
+        }
+        query.cpuStart = Now();
+        glBeginQuery( GL_TIME_ELAPSED, query.id );
+        set.push_back( query );
+    }
+
+
+    void EndGpu()
+    {
+        if ( !enabled )
+            return;
+        glEndQuery( GL_TIME_ELAPSED );
+    }
+
+
+    // Reads back every outstanding query. Call before Report() or WriteChromeTrace().
+    void Flush()
+    {
+        CollectGpuResults( queries[0] );
+        CollectGpuResults( queries[1] );
+    }
+
+
+    void Report( std::ostream& out )
+    {
+        out << std::fixed << std::setprecision( 3 );
+        out << "CPU scopes (ms)              count      min      avg      p99      max" << std::endl;
+        for ( size_t i = 0; i < cpuNodes.size(); i++ )
+            if ( cpuNodes[i].parent == -1 )
+                ReportNode( out, cpuNodes, (int) i, 0 );
+        if ( !gpuNodes.empty() )
+        {
+            out << "GPU scopes (ms)" << std::endl;
+            for ( size_t i = 0; i < gpuNodes.size(); i++ )
+                ReportNode( out, gpuNodes, (int) i, 0 );
+        }
+        out << std::defaultfloat;
+    }
+
+
+    // Summary of every scope, CPU scopes first in tree order. Call Flush() first.
+    std::vector<ProfileStats> GetStats() const
+    {
+        std::vector<ProfileStats> stats;
+        for ( size_t i = 0; i < cpuNodes.size(); i++ )
+            if ( cpuNodes[i].parent == -1 )
+                CollectStats( stats, cpuNodes, (int) i, "", false );
+        for ( size_t i = 0; i < gpuNodes.size(); i++ )
+            CollectStats( stats, gpuNodes, (int) i, "", true );
+        return stats;
+    }
+
+
+    // Writes the recorded events in the Chrome trace-event format (chrome://tracing, Perfetto).
+    // GPU scopes are placed on their own track, starting where the CPU issued them.
+    bool WriteChromeTrace( const std::string& filePath )
+    {
+        std::ofstream file( filePath );
+        if ( !file.is_open() )
+        {
+            std::cerr << "Error opening the trace file! " << filePath << std::endl;
+            return false;
+        }
+
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        for ( const ThreadScopes& thread : threads )
+            file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.track << ",\"args\":{\"name\":\"" << thread.name << "\"}}";
+        file << std::fixed << std::setprecision( 3 );
+        for ( const TraceEvent& event : traceEvents )
+            file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+                 << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+        file << "\n]}\n";
+        return true;
+    }
+
+
+    void Unload()
+    {
+        for ( std::vector<GpuQuery>& set : queries )
+        {
+            for ( GpuQuery& query : set )
+                glDeleteQueries( 1, &query.id );
+            set.clear();
+        }
+        if ( !freeQueries.empty() )
+            glDeleteQueries( (int) freeQueries.size(), freeQueries.data() );
+        freeQueries.clear();
+    }
+
+
+private:
+    struct Node
+    {
+        const char* name;
+        int parent;
+        std::vector<float> samples;
+    };
+
+    struct OpenScope
+    {
+        int node;
+        double start;
+    };
+
+    struct GpuQuery
+    {
+        unsigned int id = 0;
+        int node = 0;
+        double cpuStart = 0.0;
+    };
+
+    struct ThreadScopes
+    {
+        std::thread::id id;
+        const char* name;
+        // Trace track; 2 is the GPU's.
+        int track;
+        std::vector<OpenScope> openScopes;
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        // Microseconds since the profiler was created.
+        double start;
+        double duration;
+        int track;
+    };
+
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    long long frameIndex = 0;
+    std::vector<Node> cpuNodes;
+    std::vector<Node> gpuNodes;
+    // Guards everything CPU scopes touch, plus the GPU nodes and trace events.
+    std::mutex mutex;
+    std::vector<ThreadScopes> threads;
+    std::vector<GpuQuery> queries[2];
+    std::vector<unsigned int> freeQueries;
+    std::vector<TraceEvent> traceEvents;
+
+
+    double Now() const
+    {
+        return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - origin ).count();
+    }
+
+
+    // The calling thread's scopes, added on its first call. Needs the mutex.
+    ThreadScopes& GetThread()
+    {
+        std::thread::id id = std::this_thread::get_id();
+        for ( ThreadScopes& thread : threads )
+            if ( thread.id == id )
+                return thread;
+        int track = threads.empty() ? 1 : (int) threads.size() + 2;
+        threads.push_back( { id, "CPU", track, {} } );
+        return threads.back();
+    }
+
+
+    static int FindOrAddNode( std::vector<Node>& nodes, int parent, const char* name )
+    {
+        for ( size_t i = 0; i < nodes.size(); i++ )
+            if ( nodes[i].parent == parent && ( nodes[i].name == name || strcmp( nodes[i].name, name ) == 0 ) )
+                return (int) i;
+        nodes.push_back( { name, parent, {} } );
+        return (int) nodes.size() - 1;
+    }
+
+
+    void CollectGpuResults( std::vector<GpuQuery>& set )
+    {
+        for ( GpuQuery& query : set )
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v( query.id, GL_QUERY_RESULT, &nanoseconds );
+            freeQueries.push_back( query.id );
+
+            // The GPU cannot have spent longer on the work than has passed since it was
+            // issued; some drivers (llvmpipe) return garbage for the very first query.
+            double microseconds = nanoseconds / 1000.0;
+            if ( microseconds > Now() - query.cpuStart )
+                continue;
+            std::lock_guard<std::mutex> lock( mutex );
+            gpuNodes[query.node].samples.push_back( (float) ( microseconds / 1000.0 ) );
+            if ( recordTrace )
+                traceEvents.push_back( { gpuNodes[query.node].name, query.cpuStart, microseconds, 2 } );
+        }
+        set.clear();
+    }
+
+
+    static ProfileStats Summarize( const Node& node, const std::string& path, bool gpu )
+    {
+        ProfileStats stats;
+        stats.path = path;
+        stats.gpu = gpu;
+        stats.count = node.samples.size();
+        if ( node.samples.empty() )
+            return stats;
+
+        std::vector<float> sorted = node.samples;
+        std::sort( sorted.begin(), sorted.end() );
+        double sum = 0.0;
+        for ( float sample : sorted )
+            sum += sample;
+        stats.minMs = sorted.front();
+        stats.avgMs = sum / sorted.size();
+        stats.p99Ms = sorted[(size_t) std::ceil( sorted.size() * 0.99 ) - 1];
+        stats.maxMs = sorted.back();
+        return stats;
+    }
+
+
+    static void CollectStats( std::vector<ProfileStats>& stats, const std::vector<Node>& nodes, int index, const std::string& parentPath, bool gpu )
+    {
+        std::string path = parentPath.empty() ? nodes[index].name : parentPath + "/" + nodes[index].name;
+        stats.push_back( Summarize( nodes[index], path, gpu ) );
+        for ( size_t i = 0; i < nodes.size(); i++ )
+            if ( nodes[i].parent == index )
+                CollectStats( stats, nodes, (int) i, path, gpu );
+    }
+
+
+    static void ReportNode( std::ostream& out, const std::vector<Node>& nodes, int index, int depth )
+    {
+        ProfileStats stats = Summarize( nodes[index], nodes[index].name, false );
+        std::string label = std::string( depth * 2, ' ' ) + nodes[index].name;
+        out << "  " << std::left << std::setw( 26 ) << label << std::right << std::setw( 7 ) << stats.count;
+        if ( stats.count == 0 )
+        {
+            out << std::endl;
+            return;
+        }
+        out << std::setw( 9 ) << stats.minMs << std::setw( 9 ) << stats.avgMs
+            << std::setw( 9 ) << stats.p99Ms << std::setw( 9 ) << stats.maxMs << std::endl;
+
+        for ( size_t i = 0; i < nodes.size(); i++ )
+            if ( nodes[i].parent == index )
+                ReportNode( out, nodes, (int) i, depth + 1 );
+    }
+};
+
+
+// Times the enclosing block as a CPU scope nested under the scope that is open.
+class ProfileScope
+{
+public:
+    ProfileScope( Profiler& profiler, const char* name ) : profiler( profiler )
+    {
+        profiler.BeginCpu( name );
+    }
+
+
+    ~ProfileScope()
+    {
+        profiler.EndCpu();
+    }
+
+
+private:
+    Profiler& profiler;
+};
+
+
+// Times the GPU work issued inside the enclosing block.
+class GpuProfileScope
+{
+public:
+    GpuProfileScope( Profiler& profiler, const char* name ) : profiler( profiler )
+    {
+        profiler.BeginGpu( name );
+    }
+
+
+    ~GpuProfileScope()
+    {
+        profiler.EndGpu();
+    }
+
+
+private:
+    Profiler& profiler;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef PROGRAM_BINARY_CACHE_H
+#define PROGRAM_BINARY_CACHE_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+// On-disk cache of linked program binaries (ARB_get_program_binary).
+// Entries are keyed by a hash of the shader sources and the driver's vendor,
+// renderer and version strings, so a driver update simply misses the cache.
+class ProgramBinaryCache
+{
+public:
+    static inline std::string directory = "./ShaderCache";
+    static inline bool enabled = true;
+
+
+    static bool IsSupported()
+    {
+        if ( !enabled || !GLAD_GL_ARB_get_program_binary || glProgramBinary == NULL || glGetProgramBinary == NULL )
+            return false;
+        int formatCount = 0;
+        glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount );
+        return formatCount > 0;
+    }
+
+
+    static uint64_t MakeKey( const std::string& vertexCode, const std::string& fragmentCode )
+    {
+        uint64_t hash = 14695981039346656037ull;
+        HashString( hash, vertexCode );
+        HashString( hash, fragmentCode );
+        HashString( hash, GetDriverString( GL_VENDOR ) );
+        HashString( hash, GetDriverString( GL_RENDERER ) );
+        HashString( hash, GetDriverString( GL_VERSION ) );
+        return hash;
+    }
+
+
+    // Must be called before glLinkProgram for the driver to keep a retrievable binary.
+    static void PrepareForStore( unsigned int program )
+    {
+        if ( IsSupported() )
+            glProgramParameteri( program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+    }
+
+
+    // Returns true when program was successfully linked from a cached binary.
+    static bool TryLoad( unsigned int program, uint64_t key )
+    {
+        if ( !IsSupported() )
+            return false;
+
+        std::ifstream file( GetEntryPath( key ), std::ios::binary );
+        if ( !file.is_open() )
+            return false;
+
+        Header header;
+        if ( !file.read( (char*) &header, sizeof( header ) ) || header.magic != MAGIC || header.key != key || header.length <= 0 )
+            return false;
+        std::vector<char> binary( header.length );
+        if ( !file.read( binary.data(), header.length ) )
+            return false;
+
+        glProgramBinary( program, header.format, binary.data(), header.length );
+        int success = 0;
+        glGetProgramiv( program, GL_LINK_STATUS, &success );
+        return success != 0;
+    }
+
+
+    static void Store( unsigned int program, uint64_t key )
+    {
+        if ( !IsSupported() )
+            return;
+
+        Header header = { MAGIC, key, 0, 0 };
+        glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH, &header.length );
+        if ( header.length <= 0 )
+            return;
+        std::vector<char> binary( header.length );
+        glGetProgramBinary( program, header.length, NULL, &header.format, binary.data() );
+
+        std::error_code error;
+        std::filesystem::create_directories( directory, error );
+        std::string path = GetEntryPath( key );
+        std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file( tempPath, std::ios::binary );
+            if ( !file.is_open() )
+            {
+                std::cerr << "Error writing the program binary cache! " << tempPath << std::endl;
+                return;
+            }
+            file.write( (const char*) &header, sizeof( header ) );
+            file.write( binary.data(), header.length );
+        }
+        // Rename so a concurrently starting process never reads a half-written entry.
+        std::filesystem::rename( tempPath, path, error );
+    }
+
+
+private:
+    static constexpr uint32_t MAGIC = 0x42504243;   // "CBPB"
+
+    struct Header
+    {
+        uint32_t magic;
+        uint64_t key;
+        unsigned int format;
+        int length;
+    };
+
+
+    static void HashString( uint64_t& hash, const std::string& text )
+    {
+        // FNV-1a, including the terminator so "ab"+"c" and "a"+"bc" differ.
+        for ( size_t i = 0; i <= text.size(); i++ )
+        {
+            hash ^= (unsigned char) ( i < text.size() ? text[i] : '\0' );
+            hash *= 1099511628211ull;
+        }
+    }
+
+
+    static std::string GetDriverString( unsigned int name )
+    {
+        const char* value = (const char*) glGetString( name );
+        return value != NULL ? value : "";
+    }
+
+
+    static std::string GetEntryPath( uint64_t key )
+    {
+        char name[32];
+        snprintf( name, sizeof( name ), "%016llx.bin", (unsigned long long) key );
+        return directory + "/" + name;
+    }
+};
+
+#endif
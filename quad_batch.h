@@ -0,0 +1,194 @@
+#ifndef QUAD_BATCH_H
+#define QUAD_BATCH_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "gl_state_cache.h"
+#include "mesh_registry.h"
+#include "stream_buffer.h"
+#include "vertex_layout.h"
+
+
+struct QuadInstance
+{
+    float x, y;
+    float scaleX, scaleY;
+    float rotation;
+    float r, g, b, a;
+};
+
+
+// QuadInstance as Shaders/instanced.vertex reads it, one step per instance.
+constexpr VertexAttribute QUAD_INSTANCE_LAYOUT[] = {
+    { 2, 4, VertexEncoding::FLOAT, 1 },
+    { 3, 1, VertexEncoding::FLOAT, 1 },
+    { 4, 4, VertexEncoding::FLOAT, 1 },
+};
+
+
+// Draws any number of quads with one glDrawElementsInstanced call.
+// Reuses the engine's unit quad mesh from the shared mesh pools, looked up every flush
+// since defragmenting moves it, and streams the
+// per-instance transform and color through a StreamBuffer every flush.
+// Expects a program using Shaders/instanced.vertex to be bound.
+// Call BeginFrame() before the first Add() of a frame and EndFrame() after the last Flush().
+class QuadBatch
+{
+public:
+    unsigned int vao = 0;
+    StreamBuffer instanceBuffer;
+
+    // Totals since the last ResetStats().
+    int drawCalls = 0;
+    int quadsDrawn = 0;
+    // Quads lost because the stream buffer could not be grown or mapped.
+    int quadsDropped = 0;
+
+
+    // quadMesh is the unit quad in meshes, which must outlive the batch.
+    // maxInstancesPerFrame only sizes the stream buffer to start with; it grows as needed.
+    void Init( const MeshRegistry& meshes, int quadMesh, int maxInstancesPerFrame = 65536, bool persistentMapping = true )
+    {
+        this->meshes = &meshes;
+        this->quadMesh = quadMesh;
+        int format = meshes.Get( quadMesh ).format;
+
+        glGenVertexArrays( 1, &vao );
+        GLStateCache::BindVertexArray( vao );
+        GLStateCache::BindBuffer( GL_ARRAY_BUFFER, meshes.GetVertexBuffer( format ) );
+        GLStateCache::BindBuffer( GL_ELEMENT_ARRAY_BUFFER, meshes.GetIndexBuffer( format ) );
+        meshes.GetFormat( format ).PointAttributes( 0 );
+
+        instanceBuffer.Init( GL_ARRAY_BUFFER, (size_t) maxInstancesPerFrame * sizeof( QuadInstance ), persistentMapping );
+        GLStateCache::BindBuffer( GL_ARRAY_BUFFER, instanceBuffer.id );
+        instanceFormat.PointAttributes( 0 );
+
+        GLStateCache::BindVertexArray( 0 );
+    }
+
+
+    void Unload()
+    {
+        GLStateCache::DeleteVertexArray( vao );
+        instanceBuffer.Unload();
+    }
+
+
+    void BeginFrame()
+    {
+        instanceBuffer.BeginFrame();
+    }
+
+
+    void EndFrame()
+    {
+        instanceBuffer.EndFrame();
+    }
+
+
+    void Add( const QuadInstance& instance )
+    {
+        instances.push_back( instance );
+    }
+
+
+    void Flush()
+    {
+        if ( instances.empty() )
+            return;
+
+        const Mesh& quad = meshes->Get( quadMesh );
+        GLStateCache::BindVertexArray( vao );
+        // Quads that no longer fit in this frame's stream region go to storage twice the
+        // size, so a frame larger than any before costs a reallocation, not a dropped quad.
+        size_t first = 0;
+        while ( first < instances.size() )
+        {
+            size_t count = instanceBuffer.Available( ALIGNMENT ) / sizeof( QuadInstance );
+            if ( count < instances.size() - first )
+            {
+                size_t frameSize = std::max( instanceBuffer.GetFrameSize(), sizeof( QuadInstance ) );
+                while ( frameSize < ( instances.size() - first ) * sizeof( QuadInstance ) )
+                    frameSize *= 2;
+                instanceBuffer.Resize( frameSize );
+                count = instanceBuffer.Available( ALIGNMENT ) / sizeof( QuadInstance );
+            }
+            if ( count > instances.size() - first )
+                count = instances.size() - first;
+
+            StreamAllocation allocation;
+            if ( count > 0 )
+                allocation = instanceBuffer.Allocate( count * sizeof( QuadInstance ), ALIGNMENT );
+            if ( allocation.data == nullptr )
+            {
+                quadsDropped += (int) ( instances.size() - first );
+                break;
+            }
+            memcpy( allocation.data, &instances[first], allocation.size );
+            instanceBuffer.Commit( allocation );
+
+            PointInstanceAttributes( allocation.offset );
+            glDrawElementsInstancedBaseVertex( GL_TRIANGLES, quad.indexCount, quad.indexType, IndexOffset( quad ), (int) count, quad.baseVertex );
+            drawCalls++;
+            quadsDrawn += (int) count;
+            first += count;
+        }
+        instances.clear();
+    }
+
+
+    // Reference path: one draw per quad, feeding the instance data through constant
+    // vertex attributes on the mesh pool's VAO. Kept for comparing against Flush().
+    void FlushPerObject()
+    {
+        const Mesh& quad = meshes->Get( quadMesh );
+        GLStateCache::BindVertexArray( quad.vao );
+        for ( const QuadInstance& instance : instances )
+        {
+            glVertexAttrib4f( 2, instance.x, instance.y, instance.scaleX, instance.scaleY );
+            glVertexAttrib1f( 3, instance.rotation );
+            glVertexAttrib4f( 4, instance.r, instance.g, instance.b, instance.a );
+            glDrawElementsBaseVertex( GL_TRIANGLES, quad.indexCount, quad.indexType, IndexOffset( quad ), quad.baseVertex );
+            drawCalls++;
+        }
+
+        quadsDrawn += (int) instances.size();
+        instances.clear();
+    }
+
+
+    void ResetStats()
+    {
+        drawCalls = 0;
+        quadsDrawn = 0;
+        quadsDropped = 0;
+    }
+
+
+private:
+    static const size_t ALIGNMENT = 16;
+
+    std::vector<QuadInstance> instances;
+    const MeshRegistry* meshes = nullptr;
+    int quadMesh = -1;
+    VertexFormat instanceFormat = VertexFormat( QUAD_INSTANCE_LAYOUT );
+
+
+    static void* IndexOffset( const Mesh& quad )
+    {
+        return (void*) ( quad.firstIndex * ( quad.indexType == GL_UNSIGNED_SHORT ? sizeof( unsigned short ) : sizeof( unsigned int ) ) );
+    }
+
+
+    // Instance data moves around the stream buffer, so the pointers are re-aimed per draw.
+    void PointInstanceAttributes( size_t offset )
+    {
+        GLStateCache::BindBuffer( GL_ARRAY_BUFFER, instanceBuffer.id );
+        instanceFormat.PointAttributes( offset, false );
+    }
+};
+
+#endif
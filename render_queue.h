@@ -0,0 +1,423 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "glad/glad.h"
+#include <cstdint>
+#include <vector>
+#include "gl_state_cache.h"
+#include "shader.h"
+#include "stream_buffer.h"
+#include "uniform_buffer.h"
+
+
+// What to draw once the program and VAO are bound.
+struct DrawCommand
+{
+    Shader* shader = nullptr;
+    unsigned int vao = 0;
+    unsigned int mode = GL_TRIANGLES;
+    int first = 0;
+    int count = 0;
+    // Added to every index; only used by indexed draws.
+    int baseVertex = 0;
+    // 0 for glDrawArrays, otherwise the index type for glDrawElements.
+    unsigned int indexType = 0;
+    int instanceCount = 1;
+    // Optional vec4 uniform set on the program right before this draw; -1 for none.
+    int uniformHandle = -1;
+    float uniformValue[4] = {};
+    // Block of the queue's material buffer to bind before this draw; -1 leaves it as is.
+    int material = -1;
+};
+
+
+// Layout glMultiDrawElementsIndirect reads from the GL_DRAW_INDIRECT_BUFFER.
+struct DrawElementsIndirectCommand
+{
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t baseVertex;
+    // Must be 0 before GL 4.2.
+    uint32_t baseInstance;
+};
+
+
+// One frame of recorded draws: sort keys, each pointing at its command.
+struct DrawList
+{
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<Entry> keys;
+    std::vector<DrawCommand> commands;
+
+
+    void Clear()
+    {
+        keys.clear();
+        commands.clear();
+    }
+};
+
+
+// Records draws as 64-bit sort keys plus a payload, radix-sorts them once per frame
+// and replays them in key order, only rebinding the program or VAO when it changes.
+//
+// Key layout, most significant first:
+//   pass (4) | shader (12) | material (12) | vao (12) | depth (24)
+//
+// Recording and execution can happen on different threads: Swap() hands the recorded
+// DrawList over, and Execute( list ) replays one without touching the recording.
+//
+// Outside SUBMIT_PER_DRAW, runs of neighbouring indexed draws that share program, VAO,
+// material and primitive, and set no per-draw uniform, go out as a single multi-draw.
+class RenderQueue
+{
+public:
+    static const int PASS_OPAQUE = 0;
+    static const int PASS_TRANSPARENT = 1;
+    static const int PASS_OVERLAY = 2;
+
+    // One GL draw per command.
+    static const int SUBMIT_PER_DRAW = 0;
+    // glMultiDrawElementsBaseVertex with client-side arrays; core since 3.2.
+    static const int SUBMIT_MULTI_DRAW = 1;
+    // glMultiDrawElementsIndirect from a streamed command buffer; needs ARB_multi_draw_indirect
+    // and falls back to SUBMIT_MULTI_DRAW without it.
+    static const int SUBMIT_INDIRECT = 2;
+
+    int submitMode = SUBMIT_PER_DRAW;
+
+    // Totals since the last ResetStats().
+    // GL draw calls; a multi-draw counts once.
+    long long drawCalls = 0;
+    long long commandsDrawn = 0;
+    long long programBinds = 0;
+    long long programBindsSkipped = 0;
+    long long vaoBinds = 0;
+    long long vaoBindsSkipped = 0;
+    long long uniformUpdates = 0;
+    long long materialBinds = 0;
+    long long materialBindsSkipped = 0;
+
+    // Per-material constants selected by DrawCommand::material; may be null.
+    UniformBuffer* materials = nullptr;
+
+
+    // depth is expected in [0, 1]; callers flip it for back-to-front passes.
+    static uint64_t MakeKey( int pass, unsigned int shader, unsigned int material, unsigned int vao, float depth )
+    {
+        if ( depth < 0.0f )
+            depth = 0.0f;
+        if ( depth > 1.0f )
+            depth = 1.0f;
+        uint64_t quantizedDepth = (uint64_t) ( depth * 0xFFFFFF );
+        return ( (uint64_t) ( pass & 0xF ) << 60 )
+             | ( (uint64_t) ( shader & 0xFFF ) << 48 )
+             | ( (uint64_t) ( material & 0xFFF ) << 36 )
+             | ( (uint64_t) ( vao & 0xFFF ) << 24 )
+             | quantizedDepth;
+    }
+
+
+    static uint64_t MakeKey( int pass, const DrawCommand& command, unsigned int material, float depth )
+    {
+        return MakeKey( pass, command.shader != nullptr ? command.shader->id : 0, material, command.vao, depth );
+    }
+
+
+    void Submit( uint64_t key, const DrawCommand& command )
+    {
+        recording.keys.push_back( { key, (uint32_t) recording.commands.size() } );
+        recording.commands.push_back( command );
+    }
+
+
+    // Exchanges the recorded draws with list, which should be empty; for handing a frame
+    // to whichever thread executes it.
+    void Swap( DrawList& list )
+    {
+        std::swap( recording.keys, list.keys );
+        std::swap( recording.commands, list.commands );
+        recording.Clear();
+    }
+
+
+    // LSD radix sort over 8-bit digits; digits that are equal for every key are skipped,
+    // which is most of them for a typical frame.
+    void Sort()
+    {
+        std::vector<DrawList::Entry>& keys = recording.keys;
+        size_t count = keys.size();
+        scratch.resize( count );
+        for ( int shift = 0; shift < 64; shift += 8 )
+        {
+            size_t histogram[256] = {};
+            for ( const DrawList::Entry& entry : keys )
+                histogram[( entry.key >> shift ) & 0xFF]++;
+            if ( count == 0 || histogram[( keys[0].key >> shift ) & 0xFF] == count )
+                continue;
+
+            size_t offset = 0;
+            for ( size_t& bucket : histogram )
+            {
+                size_t bucketSize = bucket;
+                bucket = offset;
+                offset += bucketSize;
+            }
+            for ( const DrawList::Entry& entry : keys )
+                scratch[histogram[( entry.key >> shift ) & 0xFF]++] = entry;
+            keys.swap( scratch );
+        }
+    }
+
+
+    // Sets up the indirect command stream; without it SUBMIT_INDIRECT behaves like SUBMIT_MULTI_DRAW.
+    void InitIndirect( int maxCommandsPerFrame = 65536, bool persistentMapping = true )
+    {
+        if ( !GLAD_GL_ARB_draw_indirect || !GLAD_GL_ARB_multi_draw_indirect || glMultiDrawElementsIndirect == NULL )
+            return;
+        indirectBuffer.Init( GL_DRAW_INDIRECT_BUFFER, (size_t) maxCommandsPerFrame * sizeof( DrawElementsIndirectCommand ), persistentMapping );
+    }
+
+
+    bool IsIndirectAvailable() const
+    {
+        return indirectBuffer.id != 0;
+    }
+
+
+    void Unload()
+    {
+        if ( indirectBuffer.id != 0 )
+            indirectBuffer.Unload();
+    }
+
+
+    // Issues every recorded draw in key order and empties the queue.
+    void Execute()
+    {
+        Execute( recording );
+    }
+
+
+    // The same for a list taken with Swap(), which is emptied.
+    void Execute( DrawList& list )
+    {
+        const std::vector<DrawList::Entry>& keys = list.keys;
+        const std::vector<DrawCommand>& commands = list.commands;
+        Shader* currentShader = nullptr;
+        unsigned int currentVao = 0;
+        bool vaoBound = false;
+        int currentMaterial = -1;
+
+        int mode = submitMode;
+        if ( mode == SUBMIT_INDIRECT && !IsIndirectAvailable() )
+            mode = SUBMIT_MULTI_DRAW;
+        if ( mode == SUBMIT_INDIRECT )
+            indirectBuffer.BeginFrame();
+
+        size_t i = 0;
+        while ( i < keys.size() )
+        {
+            const DrawCommand& command = commands[keys[i].index];
+            if ( command.shader != currentShader )
+            {
+                command.shader->Use();
+                currentShader = command.shader;
+                programBinds++;
+            }
+            else
+                programBindsSkipped++;
+
+            if ( !vaoBound || command.vao != currentVao )
+            {
+                GLStateCache::BindVertexArray( command.vao );
+                currentVao = command.vao;
+                vaoBound = true;
+                vaoBinds++;
+            }
+            else
+                vaoBindsSkipped++;
+
+            if ( command.material >= 0 && materials != nullptr )
+            {
+                if ( command.material != currentMaterial )
+                {
+                    materials->Bind( command.material );
+                    currentMaterial = command.material;
+                    materialBinds++;
+                }
+                else
+                    materialBindsSkipped++;
+            }
+
+            // The handle belongs to the real program, not the fallback bound while it loads.
+            if ( command.uniformHandle >= 0 && command.shader->IsReady() )
+            {
+                const float* value = command.uniformValue;
+                command.shader->SetFloat4( command.uniformHandle, value[0], value[1], value[2], value[3] );
+                uniformUpdates++;
+            }
+
+            size_t runEnd = i + 1;
+            if ( mode != SUBMIT_PER_DRAW && CanMerge( command, mode ) )
+                while ( runEnd < keys.size() && CanJoin( command, commands[keys[runEnd].index], mode ) )
+                    runEnd++;
+            size_t runLength = runEnd - i;
+            programBindsSkipped += runLength - 1;
+            vaoBindsSkipped += runLength - 1;
+            if ( command.material >= 0 && materials != nullptr )
+                materialBindsSkipped += runLength - 1;
+
+            if ( runLength > 1 )
+                DrawRun( list, i, runEnd, mode );
+            else
+            {
+                Draw( command );
+                drawCalls++;
+            }
+            commandsDrawn += runLength;
+            i = runEnd;
+        }
+
+        if ( mode == SUBMIT_INDIRECT )
+            indirectBuffer.EndFrame();
+        list.Clear();
+    }
+
+
+    void ResetStats()
+    {
+        drawCalls = 0;
+        commandsDrawn = 0;
+        programBinds = 0;
+        programBindsSkipped = 0;
+        vaoBinds = 0;
+        vaoBindsSkipped = 0;
+        uniformUpdates = 0;
+        materialBinds = 0;
+        materialBindsSkipped = 0;
+    }
+
+
+private:
+    DrawList recording;
+    std::vector<DrawList::Entry> scratch;
+    StreamBuffer indirectBuffer;
+    std::vector<int> multiDrawCounts;
+    std::vector<void*> multiDrawOffsets;
+    std::vector<int> multiDrawBaseVertices;
+
+
+    static size_t IndexSize( unsigned int indexType )
+    {
+        return indexType == GL_UNSIGNED_SHORT ? 2 : ( indexType == GL_UNSIGNED_BYTE ? 1 : 4 );
+    }
+
+
+    // Whether command may start a multi-draw run.
+    static bool CanMerge( const DrawCommand& command, int mode )
+    {
+        if ( command.indexType == 0 || command.uniformHandle >= 0 )
+            return false;
+        // glMultiDrawElementsBaseVertex has no instance count.
+        return mode == SUBMIT_INDIRECT || command.instanceCount == 1;
+    }
+
+
+    static bool CanJoin( const DrawCommand& first, const DrawCommand& next, int mode )
+    {
+        return CanMerge( next, mode ) && next.shader == first.shader && next.vao == first.vao
+            && next.material == first.material && next.mode == first.mode && next.indexType == first.indexType;
+    }
+
+
+    // Draws list.keys[begin, end) with as few calls as possible.
+    void DrawRun( const DrawList& list, size_t begin, size_t end, int mode )
+    {
+        const std::vector<DrawList::Entry>& keys = list.keys;
+        const std::vector<DrawCommand>& commands = list.commands;
+        const DrawCommand& first = commands[keys[begin].index];
+        if ( mode == SUBMIT_INDIRECT )
+        {
+            // Runs longer than the space left in this frame's region go out in several calls.
+            const size_t alignment = sizeof( uint32_t );
+            size_t i = begin;
+            while ( i < end )
+            {
+                size_t fit = indirectBuffer.Available( alignment ) / sizeof( DrawElementsIndirectCommand );
+                if ( fit == 0 )
+                    break;
+                size_t chunk = end - i < fit ? end - i : fit;
+                StreamAllocation allocation = indirectBuffer.Allocate( chunk * sizeof( DrawElementsIndirectCommand ), alignment );
+                DrawElementsIndirectCommand* indirect = (DrawElementsIndirectCommand*) allocation.data;
+                for ( size_t j = i; j < i + chunk; j++ )
+                {
+                    const DrawCommand& command = commands[keys[j].index];
+                    *indirect++ = { (uint32_t) command.count, (uint32_t) command.instanceCount, (uint32_t) command.first, command.baseVertex, 0 };
+                }
+                indirectBuffer.Commit( allocation );
+                GLStateCache::BindBuffer( GL_DRAW_INDIRECT_BUFFER, indirectBuffer.id );
+                glMultiDrawElementsIndirect( first.mode, first.indexType, (void*) allocation.offset, (int) chunk, 0 );
+                drawCalls++;
+                i += chunk;
+            }
+            if ( i == end )
+                return;
+
+            // Out of room in this frame's region. The rest goes through the client-side
+            // multi-draw, or one by one if it has instanced draws that path cannot express.
+            for ( size_t j = i; j < end; j++ )
+                if ( commands[keys[j].index].instanceCount != 1 )
+                {
+                    for ( ; i < end; i++ )
+                    {
+                        Draw( commands[keys[i].index] );
+                        drawCalls++;
+                    }
+                    return;
+                }
+            begin = i;
+        }
+
+        multiDrawCounts.clear();
+        multiDrawOffsets.clear();
+        multiDrawBaseVertices.clear();
+        size_t indexSize = IndexSize( first.indexType );
+        for ( size_t i = begin; i < end; i++ )
+        {
+            const DrawCommand& command = commands[keys[i].index];
+            multiDrawCounts.push_back( command.count );
+            multiDrawOffsets.push_back( (void*) ( command.first * indexSize ) );
+            multiDrawBaseVertices.push_back( command.baseVertex );
+        }
+        glMultiDrawElementsBaseVertex( first.mode, multiDrawCounts.data(), first.indexType, multiDrawOffsets.data(), (int) ( end - begin ), multiDrawBaseVertices.data() );
+        drawCalls++;
+    }
+
+
+    void Draw( const DrawCommand& command )
+    {
+        if ( command.indexType == 0 )
+        {
+            if ( command.instanceCount == 1 )
+                glDrawArrays( command.mode, command.first, command.count );
+            else
+                glDrawArraysInstanced( command.mode, command.first, command.count, command.instanceCount );
+            return;
+        }
+
+        void* offset = (void*) ( command.first * IndexSize( command.indexType ) );
+        if ( command.instanceCount == 1 )
+            glDrawElementsBaseVertex( command.mode, command.count, command.indexType, offset, command.baseVertex );
+        else
+            glDrawElementsInstancedBaseVertex( command.mode, command.count, command.indexType, offset, command.instanceCount, command.baseVertex );
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <iostream>
+#include "gl_state_cache.h"
+
+
+// Offscreen color buffer the scene is drawn into at some resolution of its own, then
+// stretched onto the window's framebuffer. Storage only grows: a smaller size draws into
+// the lower-left corner of what is there, so changing the resolution every frame costs
+// nothing but the viewport.
+class RenderTarget
+{
+public:
+    unsigned int framebuffer = 0;
+    // Size drawn at; at most the allocated size.
+    int width = 0;
+    int height = 0;
+
+
+    int Init( int width, int height )
+    {
+        Unload();
+        return Resize( width, height );
+    }
+
+
+    void Unload()
+    {
+        if ( framebuffer != 0 )
+        {
+            GLStateCache::DeleteFramebuffer( framebuffer );
+            glDeleteRenderbuffers( 1, &colorRenderbuffer );
+        }
+        framebuffer = colorRenderbuffer = 0;
+        width = height = 0;
+        allocatedWidth = allocatedHeight = 0;
+    }
+
+
+    // Reallocates only when the new size does not fit.
+    int Resize( int width, int height )
+    {
+        this->width = std::max( width, 1 );
+        this->height = std::max( height, 1 );
+        if ( this->width <= allocatedWidth && this->height <= allocatedHeight )
+            return 0;
+
+        allocatedWidth = std::max( this->width, allocatedWidth );
+        allocatedHeight = std::max( this->height, allocatedHeight );
+        if ( colorRenderbuffer == 0 )
+            glGenRenderbuffers( 1, &colorRenderbuffer );
+        glBindRenderbuffer( GL_RENDERBUFFER, colorRenderbuffer );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, allocatedWidth, allocatedHeight );
+
+        if ( framebuffer == 0 )
+            glGenFramebuffers( 1, &framebuffer );
+        GLStateCache::BindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+        glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer );
+        if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+        {
+            std::cout << "Failed to create the scene render target" << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+
+    // Draws go to the target from here on, over its current size.
+    void Bind()
+    {
+        GLStateCache::BindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+        GLStateCache::Viewport( 0, 0, width, height );
+    }
+
+
+    // Stretches what was drawn over the whole of target, filtered when the sizes differ,
+    // and leaves target bound for drawing.
+    void BlitTo( unsigned int target, int targetWidth, int targetHeight )
+    {
+        GLStateCache::BindFramebuffer( GL_READ_FRAMEBUFFER, framebuffer );
+        GLStateCache::BindFramebuffer( GL_DRAW_FRAMEBUFFER, target );
+        bool sameSize = width == targetWidth && height == targetHeight;
+        glBlitFramebuffer( 0, 0, width, height, 0, 0, targetWidth, targetHeight, GL_COLOR_BUFFER_BIT, sameSize ? GL_NEAREST : GL_LINEAR );
+        GLStateCache::BindFramebuffer( GL_FRAMEBUFFER, target );
+        GLStateCache::Viewport( 0, 0, targetWidth, targetHeight );
+    }
+
+
+private:
+    unsigned int colorRenderbuffer = 0;
+    int allocatedWidth = 0;
+    int allocatedHeight = 0;
+};
+
+#endif
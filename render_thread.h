@@ -0,0 +1,130 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+// Runs the GL side of each frame on a thread of its own. The main thread records frame
+// packets and hands them over in order; the render thread draws them one by one. There
+// are PACKET_COUNT packets, so the main thread can record the next frame while the last
+// one is being drawn, and waits only when it gets a whole frame ahead.
+//
+// The packets themselves belong to the caller; this only hands out their indices.
+//
+//   renderThread.Start( [&]() { MakeContextCurrent(); }, [&]( int packet ) { Draw( packets[packet] ); }, [&]() { ReleaseContext(); } );
+//   int packet = renderThread.AcquirePacket();
+//   Record( packets[packet] );
+//   renderThread.SubmitPacket();
+//   ...
+//   renderThread.Stop();
+class RenderThread
+{
+public:
+    static const int PACKET_COUNT = 2;
+
+    // Totals since Start(), in seconds: the main thread waiting for a free packet, and the
+    // render thread waiting for a submitted one.
+    double acquireWaitSeconds = 0.0;
+    double renderIdleSeconds = 0.0;
+
+
+    // begin runs on the new thread before the first packet, end after the last.
+    void Start( std::function<void()> begin, std::function<void( int )> render, std::function<void()> end )
+    {
+        submitted = 0;
+        rendered = 0;
+        stopping = false;
+        acquireWaitSeconds = 0.0;
+        renderIdleSeconds = 0.0;
+        this->render = render;
+        thread = std::thread( [this, begin, end]()
+        {
+            begin();
+            Run();
+            end();
+        } );
+    }
+
+
+    bool IsRunning() const
+    {
+        return thread.joinable();
+    }
+
+
+    // Index of the packet to record next. Waits while the render thread still draws it.
+    int AcquirePacket()
+    {
+        std::unique_lock<std::mutex> lock( mutex );
+        auto start = std::chrono::steady_clock::now();
+        packetRendered.wait( lock, [this]() { return submitted - rendered < PACKET_COUNT; } );
+        acquireWaitSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        return (int) ( submitted % PACKET_COUNT );
+    }
+
+
+    // Hands the packet from the last AcquirePacket() to the render thread.
+    void SubmitPacket()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            submitted++;
+        }
+        packetSubmitted.notify_one();
+    }
+
+
+    // Draws every submitted packet, then joins the thread.
+    void Stop()
+    {
+        if ( !thread.joinable() )
+            return;
+        {
+            std::lock_guard<std::mutex> lock( mutex );
+            stopping = true;
+        }
+        packetSubmitted.notify_one();
+        thread.join();
+    }
+
+
+private:
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable packetSubmitted;
+    std::condition_variable packetRendered;
+    std::function<void( int )> render;
+    long long submitted = 0;
+    long long rendered = 0;
+    bool stopping = false;
+
+
+    void Run()
+    {
+        while ( true )
+        {
+            long long packet;
+            {
+                std::unique_lock<std::mutex> lock( mutex );
+                auto start = std::chrono::steady_clock::now();
+                packetSubmitted.wait( lock, [this]() { return rendered < submitted || stopping; } );
+                renderIdleSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+                if ( rendered == submitted )
+                    return;
+                packet = rendered;
+            }
+            render( (int) ( packet % PACKET_COUNT ) );
+            {
+                std::lock_guard<std::mutex> lock( mutex );
+                rendered++;
+            }
+            packetRendered.notify_one();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef RESOLUTION_SCALER_H
+#define RESOLUTION_SCALER_H
+
+#include "glad/glad.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+// GPU time of whole frames from GL_TIMESTAMP counters, which unlike GL_TIME_ELAPSED queries
+// can be taken while a profiler scope is timing. Results are read FRAME_COUNT frames
+// later, by when the GPU has long finished them, so reading never stalls.
+class GpuFrameTimer
+{
+public:
+    static const int FRAME_COUNT = 4;
+
+
+    void Init()
+    {
+        Unload();
+        glGenQueries( FRAME_COUNT * 2, queries );
+        frameIndex = 0;
+    }
+
+
+    void Unload()
+    {
+        if ( queries[0] != 0 )
+            glDeleteQueries( FRAME_COUNT * 2, queries );
+        std::fill( queries, queries + FRAME_COUNT * 2, 0u );
+        std::fill( issued, issued + FRAME_COUNT, false );
+    }
+
+
+    // Starts timing a frame. Returns the GPU milliseconds of the frame that last used this
+    // slot, or a negative number when there is none yet.
+    float BeginFrame()
+    {
+        int slot = (int) ( frameIndex % FRAME_COUNT );
+        float milliseconds = -1.0f;
+        if ( issued[slot] )
+        {
+            uint64_t start = 0;
+            uint64_t end = 0;
+            glGetQueryObjectui64v( queries[slot * 2], GL_QUERY_RESULT, &start );
+            glGetQueryObjectui64v( queries[slot * 2 + 1], GL_QUERY_RESULT, &end );
+            // Some drivers (llvmpipe) return garbage for the very first query.
+            if ( end > start && frameIndex > FRAME_COUNT )
+                milliseconds = (float) ( ( end - start ) / 1000000.0 );
+        }
+        glQueryCounter( queries[slot * 2], GL_TIMESTAMP );
+        return milliseconds;
+    }
+
+
+    void EndFrame()
+    {
+        int slot = (int) ( frameIndex % FRAME_COUNT );
+        glQueryCounter( queries[slot * 2 + 1], GL_TIMESTAMP );
+        issued[slot] = true;
+        frameIndex++;
+    }
+
+
+private:
+    unsigned int queries[FRAME_COUNT * 2] = {};
+    bool issued[FRAME_COUNT] = {};
+    long long frameIndex = 0;
+};
+
+
+// Picks the scene's render scale, a fraction of the window size per axis, to hold the GPU
+// frame time at a target. GPU time is taken to follow the pixel count, the square of the
+// scale, so a frame over target shrinks the scale by the square root of the overshoot at
+// once. Growing back is slower and only starts under growThreshold of the target, so the
+// scale does not oscillate around the point where it just fits. After each change the
+// scale holds for SETTLE_FRAMES, since GPU times arrive a few frames late. A shrink that
+// does not make frames faster, as when the upscale costs more than the pixels saved, is
+// undone, and the scale stays at or above where it was for RETRY_FRAMES.
+//
+// Some drivers' timestamps miss the frame's real work: software renderers such as llvmpipe
+// rasterize inside the GL calls, so the GPU time comes back as a fraction of a millisecond.
+// Once the GPU time has settled under untrackedRatio of the CPU time the frame's GL calls
+// took, the CPU time is held at the target instead for the rest of the run.
+//
+//   scaler.Init( 0.5f, 1.0f, 16.6f );
+//   float scale = scaler.Update( gpuMilliseconds, cpuMilliseconds );
+class ResolutionScaler
+{
+public:
+    static const int SETTLE_FRAMES = 12;
+    static const int RETRY_FRAMES = 240;
+
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    float targetMs = 16.6f;
+    // Grow only while the GPU time is under this fraction of the target.
+    float growThreshold = 0.85f;
+    // Most the scale grows by in one change.
+    float maxGrowStep = 0.05f;
+    float untrackedRatio = 0.1f;
+    float scale = 1.0f;
+    // Whether Update() goes by the CPU time, the GPU timestamps not tracking the frame.
+    bool cpuTimed = false;
+
+    // Totals since Init().
+    long long frames = 0;
+    long long samples = 0;
+    long long changes = 0;
+    long long shrinksUndone = 0;
+    long long cpuTimedFrames = 0;
+    double scaleTotal = 0.0;
+    double gpuMsTotal = 0.0;
+    double cpuMsTotal = 0.0;
+
+
+    void Init( float minScale, float maxScale, float targetMs )
+    {
+        this->minScale = std::min( std::max( minScale, 0.1f ), 1.0f );
+        this->maxScale = std::min( std::max( maxScale, this->minScale ), 1.0f );
+        this->targetMs = targetMs;
+        scale = this->maxScale;
+        cpuTimed = false;
+        smoothedGpuMs = smoothedCpuMs = 0.0f;
+        framesSinceChange = 0;
+        checkShrink = false;
+        floorScale = 0.0f;
+        floorFrames = 0;
+        frames = samples = changes = shrinksUndone = cpuTimedFrames = 0;
+        scaleTotal = gpuMsTotal = cpuMsTotal = 0.0;
+    }
+
+
+    // Feeds one GPU frame time and the CPU time of a frame's GL calls, negative for none, and
+    // returns the scale to draw at. Both may be from a few frames back.
+    float Update( float gpuMs, float cpuMs )
+    {
+        frames++;
+        framesSinceChange++;
+        if ( gpuMs >= 0.0f && cpuMs >= 0.0f )
+        {
+            smoothedGpuMs = samples == 0 ? gpuMs : smoothedGpuMs + ( gpuMs - smoothedGpuMs ) * 0.25f;
+            smoothedCpuMs = samples == 0 ? cpuMs : smoothedCpuMs + ( cpuMs - smoothedCpuMs ) * 0.25f;
+            samples++;
+            gpuMsTotal += gpuMs;
+            cpuMsTotal += cpuMs;
+        }
+        // Decided before the first change, while the scale is the same for both times.
+        if ( !cpuTimed && changes == 0 && samples >= SETTLE_FRAMES && smoothedGpuMs < smoothedCpuMs * untrackedRatio )
+            cpuTimed = true;
+        if ( cpuTimed )
+            cpuTimedFrames++;
+        if ( floorFrames > 0 && --floorFrames == 0 )
+            floorScale = 0.0f;
+        float smoothedMs = cpuTimed ? smoothedCpuMs : smoothedGpuMs;
+        if ( samples >= SETTLE_FRAMES && framesSinceChange >= SETTLE_FRAMES && targetMs > 0.0f )
+        {
+            float next = scale;
+            if ( checkShrink && smoothedMs >= msBeforeShrink * 0.95f )
+            {
+                next = scaleBeforeShrink;
+                floorScale = scaleBeforeShrink;
+                floorFrames = RETRY_FRAMES;
+                shrinksUndone++;
+            }
+            else
+            {
+                float wanted = scale * std::sqrt( targetMs / std::max( smoothedMs, 0.001f ) );
+                if ( smoothedMs > targetMs )
+                    next = std::max( wanted, floorScale );
+                else if ( smoothedMs < targetMs * growThreshold )
+                    next = std::min( wanted, scale + maxGrowStep );
+            }
+            checkShrink = false;
+            next = std::min( std::max( next, minScale ), maxScale );
+            if ( std::fabs( next - scale ) >= 0.01f )
+            {
+                if ( next < scale )
+                {
+                    checkShrink = true;
+                    scaleBeforeShrink = scale;
+                    msBeforeShrink = smoothedMs;
+                }
+                scale = next;
+                framesSinceChange = 0;
+                changes++;
+            }
+        }
+        scaleTotal += scale;
+        return scale;
+    }
+
+
+private:
+    float smoothedGpuMs = 0.0f;
+    float smoothedCpuMs = 0.0f;
+    int framesSinceChange = 0;
+    // Set by a shrink until the next decision, which undoes it unless frames got faster.
+    bool checkShrink = false;
+    float scaleBeforeShrink = 1.0f;
+    float msBeforeShrink = 0.0f;
+    // No shrinking below floorScale for floorFrames more frames.
+    float floorScale = 0.0f;
+    int floorFrames = 0;
+};
+
+#endif
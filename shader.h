@@ -7,62 +7,217 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include "gl_state_cache.h"
+#include "program_binary_cache.h"
 
 
 class Shader
 {
+    friend class ShaderBatch;
+
 public:
-    unsigned int id;
+    unsigned int id = 0;
     unsigned int vertex;
     unsigned int fragment;
+    bool loadedFromCache = false;
+    // Bound by Use() while this program is still compiling in a ShaderBatch.
+    Shader* fallback = nullptr;
 
 
     Shader( const char* vertexPath, const char* fragmentPath )
     {
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        SubmitCompile( vertexPath, fragmentPath );
+        SubmitLink();
+        Finish();
+    }
 
-        TryLoadCodeFromFile( vertexPath, vertexCode );
-        TryLoadCodeFromFile( fragmentPath, fragmentCode );
-        CompileShaders( vertexCode, fragmentCode );
-        CreateShaderProgram();
-        DeleteShaders();
+
+    ~Shader()
+    {
+        GLStateCache::DeleteProgram( id );
+    }
+
+
+    // False until a batched program has finished linking; always true for the blocking constructor.
+    bool IsReady() const
+    {
+        return ready;
     }
 
 
     void Use() 
     { 
-        glUseProgram( id ); 
+        if ( !ready && fallback != nullptr )
+        {
+            fallback->Use();
+            return;
+        }
+        GLStateCache::UseProgram( id ); 
+    }
+
+
+    // Resolves a uniform name once; pass the result to the handle-based setters every frame.
+    // Returns -1 for names that are not active in the program, which GL silently ignores.
+    int GetUniformHandle( const std::string &name ) const
+    {
+        auto it = uniformLocations.find( name );
+        return it != uniformLocations.end() ? it->second : -1;
+    }
+
+
+    // Every program that finishes loading after this binds its block called name to
+    // bindingPoint. size is the matching C++ struct; std140 blocks of another size are reported.
+    static void RegisterUniformBlock( const std::string &name, unsigned int bindingPoint, size_t size )
+    {
+        registeredBlocks[name] = { bindingPoint, size };
+    }
+
+
+    // -1 when the program has no active block with this name.
+    int GetUniformBlockSize( const std::string &name ) const
+    {
+        auto it = uniformBlocks.find( name );
+        return it != uniformBlocks.end() ? it->second.size : -1;
+    }
+
+
+    bool SetUniformBlockBinding( const std::string &name, unsigned int bindingPoint ) const
+    {
+        auto it = uniformBlocks.find( name );
+        if ( it == uniformBlocks.end() )
+            return false;
+        glUniformBlockBinding( id, it->second.index, bindingPoint );
+        return true;
     }
 
 
     void SetBool( const std::string &name, bool value ) const
     {         
-        glUniform1i( glGetUniformLocation( id, name.c_str() ), (int) value ); 
+        SetBool( GetUniformHandle( name ), value ); 
     }
 
 
     void SetInt( const std::string &name, int value ) const
     { 
-        glUniform1i( glGetUniformLocation( id, name.c_str() ), value ); 
+        SetInt( GetUniformHandle( name ), value ); 
     }
 
 
     void SetFloat( const std::string &name, float value ) const
     { 
-        glUniform1f( glGetUniformLocation( id, name.c_str() ), value ); 
+        SetFloat( GetUniformHandle( name ), value ); 
     }
 
 
     void SetFloat4( const std::string &name, float valueX, float valueY, float valueZ, float valueW ) const
     { 
-        glUniform4f( glGetUniformLocation( id, name.c_str() ), valueX, valueY, valueZ, valueW ); 
+        SetFloat4( GetUniformHandle( name ), valueX, valueY, valueZ, valueW ); 
+    }
+
+
+    void SetBool( int handle, bool value ) const
+    {         
+        glUniform1i( handle, (int) value ); 
+    }
+
+
+    void SetInt( int handle, int value ) const
+    { 
+        glUniform1i( handle, value ); 
+    }
+
+
+    void SetFloat( int handle, float value ) const
+    { 
+        glUniform1f( handle, value ); 
+    }
+
+
+    void SetFloat4( int handle, float valueX, float valueY, float valueZ, float valueW ) const
+    { 
+        glUniform4f( handle, valueX, valueY, valueZ, valueW ); 
     }
 
 
 private:
+    struct UniformBlock
+    {
+        unsigned int index;
+        int size;
+    };
+
+    struct RegisteredBlock
+    {
+        unsigned int bindingPoint;
+        size_t size;
+    };
+
+    static inline std::unordered_map<std::string, RegisteredBlock> registeredBlocks;
+
+    std::unordered_map<std::string, int> uniformLocations;
+    std::unordered_map<std::string, UniformBlock> uniformBlocks;
+    uint64_t cacheKey = 0;
+    bool ready = false;
+
+
+    // Only used by ShaderBatch, which drives the Submit/Finish steps itself.
+    Shader( Shader* fallback ) : fallback( fallback )
+    {
+    }
+
+
+    // Reads the sources and either links from the binary cache or queues both compiles.
+    // Nothing here waits on the driver.
+    void SubmitCompile( const char* vertexPath, const char* fragmentPath )
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+        TryLoadCodeFromFile( vertexPath, vertexCode );
+        TryLoadCodeFromFile( fragmentPath, fragmentCode );
+
+        id = glCreateProgram();
+        cacheKey = ProgramBinaryCache::MakeKey( vertexCode, fragmentCode );
+        loadedFromCache = ProgramBinaryCache::TryLoad( id, cacheKey );
+        if ( !loadedFromCache )
+            CompileShaders( vertexCode, fragmentCode );
+    }
+
+
+    void SubmitLink()
+    {
+        if ( !loadedFromCache )
+            CreateShaderProgram();
+    }
+
+
+    // With KHR_parallel_shader_compile this asks without blocking; otherwise any status query would wait.
+    bool IsLinkPending() const
+    {
+        if ( loadedFromCache || !GLAD_GL_KHR_parallel_shader_compile )
+            return false;
+        int complete = 0;
+        glGetProgramiv( id, GL_COMPLETION_STATUS_KHR, &complete );
+        return !complete;
+    }
+
+
+    void Finish()
+    {
+        if ( !loadedFromCache )
+        {
+            CheckCompileErrors( vertex, "VERTEX" );
+            CheckCompileErrors( fragment, "FRAGMENT" );
+            if ( CheckCompileErrors( id, "PROGRAM" ) )
+                ProgramBinaryCache::Store( id, cacheKey );
+            DeleteShaders();
+        }
+        ReflectUniforms();
+        ReflectUniformBlocks();
+        ready = true;
+    }
+
+
     bool TryLoadCodeFromFile( std::string filePath, std::string& code )
     {
         try
@@ -96,22 +251,19 @@ private:
         vertex = glCreateShader( GL_VERTEX_SHADER );
         glShaderSource( vertex, 1, &vShaderCode, NULL );
         glCompileShader( vertex );
-        CheckCompileErrors( vertex, "VERTEX" );
         
         fragment = glCreateShader( GL_FRAGMENT_SHADER );
         glShaderSource( fragment, 1, &fShaderCode, NULL );
         glCompileShader( fragment );
-        CheckCompileErrors( fragment, "FRAGMENT" );
     }
 
 
     void CreateShaderProgram()
     {
-        id = glCreateProgram();
         glAttachShader( id, vertex );
         glAttachShader( id, fragment );
+        ProgramBinaryCache::PrepareForStore( id );
         glLinkProgram( id );
-        CheckCompileErrors( id, "PROGRAM" );
     }
 
 
@@ -122,7 +274,67 @@ private:
     }
 
 
-    void CheckCompileErrors( unsigned int shader, std::string type )
+    // Caches the location of every active uniform so setters never ask the driver by name.
+    void ReflectUniforms()
+    {
+        int uniformCount = 0;
+        int maxNameLength = 0;
+        glGetProgramiv( id, GL_ACTIVE_UNIFORMS, &uniformCount );
+        glGetProgramiv( id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength );
+
+        std::string name( maxNameLength, '\0' );
+        for ( int i = 0; i < uniformCount; i++ )
+        {
+            int length = 0;
+            int size = 0;
+            unsigned int type = 0;
+            glGetActiveUniform( id, i, maxNameLength, &length, &size, &type, &name[0] );
+
+            std::string uniformName = name.substr( 0, length );
+            int location = glGetUniformLocation( id, uniformName.c_str() );
+            if ( location < 0 )
+                continue;   // Lives in a uniform block.
+
+            uniformLocations[uniformName] = location;
+            // Arrays are reported as "name[0]"; also accept the bare name like glGetUniformLocation does.
+            size_t bracket = uniformName.find( '[' );
+            if ( bracket != std::string::npos )
+                uniformLocations[uniformName.substr( 0, bracket )] = location;
+        }
+    }
+
+
+    // Block bindings are not part of the program binary, so this runs on every load.
+    void ReflectUniformBlocks()
+    {
+        int blockCount = 0;
+        int maxNameLength = 0;
+        glGetProgramiv( id, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount );
+        glGetProgramiv( id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength );
+
+        std::string name( maxNameLength, '\0' );
+        for ( int i = 0; i < blockCount; i++ )
+        {
+            int length = 0;
+            int size = 0;
+            glGetActiveUniformBlockName( id, i, maxNameLength, &length, &name[0] );
+            glGetActiveUniformBlockiv( id, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size );
+
+            std::string blockName = name.substr( 0, length );
+            uniformBlocks[blockName] = { (unsigned int) i, size };
+
+            auto registered = registeredBlocks.find( blockName );
+            if ( registered == registeredBlocks.end() )
+                continue;
+            if ( (size_t) size != registered->second.size )
+                std::cout << "WARNING::SHADER::UNIFORM_BLOCK_SIZE_MISMATCH: " << blockName << " is " << size
+                          << " bytes in the shader, " << registered->second.size << " in the engine" << std::endl;
+            glUniformBlockBinding( id, i, registered->second.bindingPoint );
+        }
+    }
+
+
+    bool CheckCompileErrors( unsigned int shader, std::string type )
     {
         int success;
         char infoLog[1024];
@@ -144,6 +356,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
             }
         }
+        return success != 0;
     }
 };
 
@@ -0,0 +1,92 @@
+#ifndef SHADER_BATCH_H
+#define SHADER_BATCH_H
+
+#include "glad/glad.h"
+#include <string>
+#include <vector>
+#include "shader.h"
+
+
+// Creates many programs at once without serializing the driver's compiler.
+// Submit() queues every compile and then every link before any status is read,
+// so drivers with KHR_parallel_shader_compile build them on their own threads.
+// Poll() finalizes whatever has finished; until then Shader::Use() binds the fallback.
+class ShaderBatch
+{
+public:
+    // The returned shader is owned by the caller and can be used (through its fallback) right away.
+    Shader* Add( const char* vertexPath, const char* fragmentPath, Shader* fallback = nullptr )
+    {
+        Entry entry;
+        entry.shader = new Shader( fallback );
+        entry.vertexPath = vertexPath;
+        entry.fragmentPath = fragmentPath;
+        queued.push_back( entry );
+        return entry.shader;
+    }
+
+
+    void Submit()
+    {
+        if ( GLAD_GL_KHR_parallel_shader_compile )
+            glMaxShaderCompilerThreadsKHR( 0xFFFFFFFF );   // Let the driver pick the thread count.
+
+        for ( Entry& entry : queued )
+            entry.shader->SubmitCompile( entry.vertexPath.c_str(), entry.fragmentPath.c_str() );
+        for ( Entry& entry : queued )
+        {
+            entry.shader->SubmitLink();
+            pending.push_back( entry.shader );
+        }
+        queued.clear();
+    }
+
+
+    // Finalizes finished programs and returns how many are still compiling. Never blocks
+    // when the driver supports parallel compiles; otherwise finishes one program per call
+    // so the cost is spread over several frames.
+    int Poll()
+    {
+        for ( size_t i = 0; i < pending.size(); )
+        {
+            if ( pending[i]->IsLinkPending() )
+            {
+                i++;
+                continue;
+            }
+            pending[i]->Finish();
+            pending.erase( pending.begin() + i );
+            if ( !GLAD_GL_KHR_parallel_shader_compile )
+                break;
+        }
+        return (int) pending.size();
+    }
+
+
+    void Wait()
+    {
+        for ( Shader* shader : pending )
+            shader->Finish();
+        pending.clear();
+    }
+
+
+    bool IsDone() const
+    {
+        return queued.empty() && pending.empty();
+    }
+
+
+private:
+    struct Entry
+    {
+        Shader* shader;
+        std::string vertexPath;
+        std::string fragmentPath;
+    };
+
+    std::vector<Entry> queued;
+    std::vector<Shader*> pending;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include "glad/glad.h"
+#include <chrono>
+#include <cstddef>
+#include "gl_state_cache.h"
+
+
+struct StreamAllocation
+{
+    // Where to write; nullptr when the frame's region is full.
+    void* data = nullptr;
+    // Byte offset of data inside the buffer, for attribute pointers and draw offsets.
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+
+// Buffer for geometry that changes every frame. The storage is split into
+// FRAME_COUNT regions used round-robin, each guarded by a fence, so the CPU writes
+// one region while the GPU still reads the others.
+//
+// With ARB_buffer_storage the whole buffer stays persistently and coherently mapped.
+// On plain 3.3 each allocation is mapped with GL_MAP_UNSYNCHRONIZED_BIT instead, and
+// a region whose fence has not signalled yet orphans the buffer rather than stalling.
+class StreamBuffer
+{
+public:
+    static const int FRAME_COUNT = 3;
+
+    unsigned int id = 0;
+    bool persistent = false;
+
+    // Totals since the last ResetStats().
+    long long fenceWaits = 0;
+    long long orphans = 0;
+    long long resizes = 0;
+    double fenceWaitSeconds = 0.0;
+
+
+    void Init( unsigned int target, size_t frameSize, bool allowPersistent = true )
+    {
+        this->target = target;
+        this->frameSize = frameSize;
+        persistent = allowPersistent && GLAD_GL_ARB_buffer_storage && glBufferStorage != NULL;
+
+        glGenBuffers( 1, &id );
+        GLStateCache::BindBuffer( target, id );
+        if ( persistent )
+        {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage( target, frameSize * FRAME_COUNT, NULL, flags );
+            mapped = (char*) glMapBufferRange( target, 0, frameSize * FRAME_COUNT, flags );
+        }
+        else
+            glBufferData( target, frameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW );
+    }
+
+
+    void Unload()
+    {
+        for ( GLsync& fence : fences )
+        {
+            if ( fence != NULL )
+                glDeleteSync( fence );
+            fence = NULL;
+        }
+        if ( mapped != nullptr )
+        {
+            GLStateCache::BindBuffer( target, id );
+            glUnmapBuffer( target );
+            mapped = nullptr;
+        }
+        GLStateCache::DeleteBuffer( id );
+        id = 0;
+    }
+
+
+    // Replaces the storage with regions of frameSize bytes and carries on in the first one.
+    // Draws already issued keep reading the old storage, which GL frees once they are done.
+    void Resize( size_t frameSize )
+    {
+        bool allowPersistent = persistent;
+        Unload();
+        Init( target, frameSize, allowPersistent );
+        frameIndex = 0;
+        frameOffset = 0;
+        resizes++;
+    }
+
+
+    size_t GetFrameSize() const
+    {
+        return frameSize;
+    }
+
+
+    // Moves to the next region, making sure the GPU is done reading it.
+    void BeginFrame()
+    {
+        frameIndex = ( frameIndex + 1 ) % FRAME_COUNT;
+        frameOffset = 0;
+
+        GLsync& fence = fences[frameIndex];
+        if ( fence == NULL )
+            return;
+
+        if ( glClientWaitSync( fence, 0, 0 ) == GL_TIMEOUT_EXPIRED )
+        {
+            if ( persistent )
+                WaitForFence( fence );
+            else
+                Orphan();
+        }
+        if ( fence != NULL )
+        {
+            glDeleteSync( fence );
+            fence = NULL;
+        }
+    }
+
+
+    // Call once all draws reading this frame's region have been issued.
+    void EndFrame()
+    {
+        fences[frameIndex] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+    }
+
+
+    size_t Available( size_t alignment = 16 ) const
+    {
+        size_t start = Align( frameOffset, alignment );
+        return start < frameSize ? frameSize - start : 0;
+    }
+
+
+    // Suballocates from this frame's region. Write to data, then Commit() before drawing.
+    StreamAllocation Allocate( size_t size, size_t alignment = 16 )
+    {
+        StreamAllocation allocation;
+        size_t start = Align( frameOffset, alignment );
+        // A persistent mapping that failed in Init() leaves nothing to write to.
+        if ( size == 0 || start + size > frameSize || ( persistent && mapped == nullptr ) )
+            return allocation;
+
+        allocation.offset = frameIndex * frameSize + start;
+        allocation.size = size;
+        frameOffset = start + size;
+
+        if ( persistent )
+            allocation.data = mapped + allocation.offset;
+        else
+        {
+            GLStateCache::BindBuffer( target, id );
+            GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+            allocation.data = glMapBufferRange( target, allocation.offset, size, access );
+        }
+        return allocation;
+    }
+
+
+    // Makes the written data visible to GL. Free with a coherent persistent mapping.
+    void Commit( const StreamAllocation& allocation )
+    {
+        if ( persistent || allocation.data == nullptr )
+            return;
+        GLStateCache::BindBuffer( target, id );
+        glUnmapBuffer( target );
+    }
+
+
+    void ResetStats()
+    {
+        fenceWaits = 0;
+        orphans = 0;
+        resizes = 0;
+        fenceWaitSeconds = 0.0;
+    }
+
+
+private:
+    unsigned int target = GL_ARRAY_BUFFER;
+    size_t frameSize = 0;
+    char* mapped = nullptr;
+    int frameIndex = 0;
+    size_t frameOffset = 0;
+    GLsync fences[FRAME_COUNT] = {};
+
+
+    static size_t Align( size_t offset, size_t alignment )
+    {
+        return ( offset + alignment - 1 ) / alignment * alignment;
+    }
+
+
+    void WaitForFence( GLsync fence )
+    {
+        fenceWaits++;
+        auto start = std::chrono::steady_clock::now();
+        while ( glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 ) == GL_TIMEOUT_EXPIRED )
+        {
+        }
+        fenceWaitSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+
+    // The GPU may still read older regions, so give the driver fresh storage for all of them.
+    void Orphan()
+    {
+        orphans++;
+        GLStateCache::BindBuffer( target, id );
+        glBufferData( target, frameSize * FRAME_COUNT, NULL, GL_STREAM_DRAW );
+        for ( GLsync& fence : fences )
+        {
+            if ( fence != NULL )
+                glDeleteSync( fence );
+            fence = NULL;
+        }
+    }
+};
+
+#endif
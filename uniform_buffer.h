@@ -0,0 +1,125 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include "glad/glad.h"
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "gl_state_cache.h"
+
+
+// Binding points of the engine-owned uniform blocks, shared by every program.
+const unsigned int FRAME_CONSTANTS_BINDING = 0;
+const unsigned int MATERIAL_CONSTANTS_BINDING = 1;
+
+
+// Mirrors the std140 FrameConstants block in the shaders; keep both in sync.
+struct FrameConstants
+{
+    // x = seconds since start, y = last frame's duration, z = frame index.
+    float time[4];
+    // xy = framebuffer size in pixels, zw = 1 / size.
+    float viewport[4];
+};
+
+
+// Mirrors the std140 MaterialConstants block in the shaders; keep both in sync.
+struct MaterialConstants
+{
+    float color[4];
+    // Free for the shader to interpret.
+    float parameters[4];
+};
+
+
+// An array of equally sized std140 blocks in one GL_UNIFORM_BUFFER. Blocks are written
+// to a CPU copy with Set(), sent to GL with one Upload() per frame, and selected for the
+// shaders with Bind(), which binds that block's range to the buffer's binding point.
+class UniformBuffer
+{
+public:
+    unsigned int id = 0;
+    unsigned int bindingPoint = 0;
+    // Bytes between blocks, blockSize rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    size_t stride = 0;
+
+
+    void Init( unsigned int bindingPoint, size_t blockSize, int blockCount = 1 )
+    {
+        this->bindingPoint = bindingPoint;
+        this->blockSize = blockSize;
+        this->blockCount = blockCount;
+
+        int alignment = 256;
+        glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+        stride = ( blockSize + alignment - 1 ) / alignment * alignment;
+        data.assign( stride * blockCount, 0 );
+
+        glGenBuffers( 1, &id );
+        GLStateCache::BindBuffer( GL_UNIFORM_BUFFER, id );
+        glBufferData( GL_UNIFORM_BUFFER, data.size(), NULL, GL_DYNAMIC_DRAW );
+        dirtyBegin = 0;
+        dirtyEnd = data.size();
+    }
+
+
+    void Unload()
+    {
+        GLStateCache::DeleteBuffer( id );
+        id = 0;
+    }
+
+
+    int GetBlockCount() const
+    {
+        return blockCount;
+    }
+
+
+    void Set( int index, const void* block )
+    {
+        if ( index < 0 || index >= blockCount )
+            return;
+        size_t offset = index * stride;
+        memcpy( &data[offset], block, blockSize );
+        dirtyBegin = offset < dirtyBegin ? offset : dirtyBegin;
+        dirtyEnd = offset + blockSize > dirtyEnd ? offset + blockSize : dirtyEnd;
+    }
+
+
+    // Sends every block changed since the last upload in a single call.
+    void Upload()
+    {
+        if ( dirtyBegin >= dirtyEnd )
+            return;
+        GLStateCache::BindBuffer( GL_UNIFORM_BUFFER, id );
+        if ( dirtyBegin == 0 && dirtyEnd >= data.size() )
+        {
+            // Fresh storage, so the upload never waits for draws still reading the old data.
+            glBufferData( GL_UNIFORM_BUFFER, data.size(), NULL, GL_DYNAMIC_DRAW );
+            glBufferSubData( GL_UNIFORM_BUFFER, 0, data.size(), data.data() );
+        }
+        else
+            glBufferSubData( GL_UNIFORM_BUFFER, dirtyBegin, dirtyEnd - dirtyBegin, &data[dirtyBegin] );
+        dirtyBegin = data.size();
+        dirtyEnd = 0;
+    }
+
+
+    void Bind( int index = 0 )
+    {
+        if ( index < 0 || index >= blockCount )
+            return;
+        GLStateCache::BindBufferRange( GL_UNIFORM_BUFFER, bindingPoint, id, index * stride, blockSize );
+    }
+
+
+private:
+    size_t blockSize = 0;
+    int blockCount = 0;
+    std::vector<char> data;
+    size_t dirtyBegin = 0;
+    size_t dirtyEnd = 0;
+};
+
+#endif
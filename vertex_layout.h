@@ -0,0 +1,348 @@
+#ifndef VERTEX_LAYOUT_H
+#define VERTEX_LAYOUT_H
+
+#include "glad/glad.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+// How one attribute is stored in the vertex buffer. Sources are always floats.
+enum class VertexEncoding
+{
+    FLOAT,
+    // 16-bit float; positions in [-2048, 2048] stay exact to 1/1024.
+    HALF,
+    // [0, 1] and [-1, 1] in 8 or 16 bits per component.
+    UNORM8,
+    SNORM8,
+    UNORM16,
+    SNORM16,
+    // Up to 4 components in one 32-bit word: 10 bits for xyz, 2 for w.
+    UNORM_10_10_10_2,
+    SNORM_10_10_10_2,
+    // A unit normal folded onto an octahedron, two SNORM16 values. Decode in GLSL with:
+    //   vec3 n = vec3( e.xy, 1.0 - abs( e.x ) - abs( e.y ) );
+    //   if ( n.z < 0.0 ) n.xy = ( 1.0 - abs( n.yx ) ) * sign( n.xy );
+    //   n = normalize( n );
+    OCTAHEDRAL,
+};
+
+
+// One entry of a layout table. components is the number of source floats per vertex
+// (3 for an octahedral normal); the stored form follows from the encoding.
+struct VertexAttribute
+{
+    unsigned int location = 0;
+    int components = 3;
+    VertexEncoding encoding = VertexEncoding::FLOAT;
+    // Step once per instance instead of per vertex when non-zero, see glVertexAttribDivisor.
+    unsigned int divisor = 0;
+};
+
+
+// A vertex layout built from a table of attributes, packed in order. Every attribute
+// starts on a 4-byte boundary, as some drivers fall off the fast path otherwise.
+//
+//   const VertexAttribute COMPACT_VERTEX[] = {
+//       { 0, 3, VertexEncoding::HALF },
+//       { 1, 3, VertexEncoding::UNORM8 },
+//   };
+//   VertexFormat format( COMPACT_VERTEX );
+class VertexFormat
+{
+public:
+    std::vector<VertexAttribute> attributes;
+
+
+    VertexFormat()
+    {
+    }
+
+
+    template <size_t N>
+    VertexFormat( const VertexAttribute ( &table )[N] ) : attributes( table, table + N )
+    {
+    }
+
+
+    size_t Stride() const
+    {
+        size_t stride = 0;
+        for ( const VertexAttribute& attribute : attributes )
+            stride += StoredSize( attribute );
+        return stride;
+    }
+
+
+    // Floats per source vertex expected by Pack().
+    int SourceComponents() const
+    {
+        int count = 0;
+        for ( const VertexAttribute& attribute : attributes )
+            count += attribute.components;
+        return count;
+    }
+
+
+    bool operator==( const VertexFormat& other ) const
+    {
+        if ( attributes.size() != other.attributes.size() )
+            return false;
+        for ( size_t i = 0; i < attributes.size(); i++ )
+        {
+            const VertexAttribute& a = attributes[i];
+            const VertexAttribute& b = other.attributes[i];
+            if ( a.location != b.location || a.components != b.components || a.encoding != b.encoding || a.divisor != b.divisor )
+                return false;
+        }
+        return true;
+    }
+
+
+    // Points the bound VAO at this layout, starting baseOffset bytes into the bound array buffer.
+    void PointAttributes( size_t baseOffset, bool enable = true ) const
+    {
+        int stride = (int) Stride();
+        size_t offset = baseOffset;
+        for ( const VertexAttribute& attribute : attributes )
+        {
+            glVertexAttribPointer( attribute.location, GLComponents( attribute ), GLType( attribute.encoding ),
+                                   IsNormalized( attribute.encoding ), stride, (void*) offset );
+            if ( enable )
+            {
+                glEnableVertexAttribArray( attribute.location );
+                glVertexAttribDivisor( attribute.location, attribute.divisor );
+            }
+            offset += StoredSize( attribute );
+        }
+    }
+
+
+    // Converts vertexCount vertices of SourceComponents() floats each into this layout.
+    std::vector<unsigned char> Pack( const float* source, int vertexCount ) const
+    {
+        size_t stride = Stride();
+        std::vector<unsigned char> packed( stride * vertexCount, 0 );
+        for ( int vertex = 0; vertex < vertexCount; vertex++ )
+        {
+            unsigned char* out = &packed[vertex * stride];
+            for ( const VertexAttribute& attribute : attributes )
+            {
+                PackAttribute( attribute, source, out );
+                source += attribute.components;
+                out += StoredSize( attribute );
+            }
+        }
+        return packed;
+    }
+
+
+    static int GLComponents( const VertexAttribute& attribute )
+    {
+        switch ( attribute.encoding )
+        {
+            case VertexEncoding::UNORM_10_10_10_2:
+            case VertexEncoding::SNORM_10_10_10_2: return 4;
+            case VertexEncoding::OCTAHEDRAL: return 2;
+            default: return attribute.components;
+        }
+    }
+
+
+    static unsigned int GLType( VertexEncoding encoding )
+    {
+        switch ( encoding )
+        {
+            case VertexEncoding::HALF: return GL_HALF_FLOAT;
+            case VertexEncoding::UNORM8: return GL_UNSIGNED_BYTE;
+            case VertexEncoding::SNORM8: return GL_BYTE;
+            case VertexEncoding::UNORM16: return GL_UNSIGNED_SHORT;
+            case VertexEncoding::SNORM16:
+            case VertexEncoding::OCTAHEDRAL: return GL_SHORT;
+            case VertexEncoding::UNORM_10_10_10_2: return GL_UNSIGNED_INT_2_10_10_10_REV;
+            case VertexEncoding::SNORM_10_10_10_2: return GL_INT_2_10_10_10_REV;
+            default: return GL_FLOAT;
+        }
+    }
+
+
+    static bool IsNormalized( VertexEncoding encoding )
+    {
+        return encoding != VertexEncoding::FLOAT && encoding != VertexEncoding::HALF;
+    }
+
+
+    // Bytes one attribute takes in a vertex, padding included.
+    static size_t StoredSize( const VertexAttribute& attribute )
+    {
+        size_t size = 0;
+        switch ( attribute.encoding )
+        {
+            case VertexEncoding::UNORM8:
+            case VertexEncoding::SNORM8: size = attribute.components; break;
+            case VertexEncoding::HALF:
+            case VertexEncoding::UNORM16:
+            case VertexEncoding::SNORM16: size = attribute.components * 2; break;
+            case VertexEncoding::UNORM_10_10_10_2:
+            case VertexEncoding::SNORM_10_10_10_2:
+            case VertexEncoding::OCTAHEDRAL: size = 4; break;
+            default: size = attribute.components * 4; break;
+        }
+        return ( size + 3 ) & ~(size_t) 3;
+    }
+
+
+    // Round to nearest even; overflow becomes infinity, tiny values flush to zero.
+    static uint16_t PackHalf( float value )
+    {
+        uint32_t bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        uint32_t sign = ( bits >> 16 ) & 0x8000;
+        uint32_t magnitude = bits & 0x7FFFFFFF;
+
+        if ( magnitude >= 0x7F800000 )
+            return (uint16_t) ( sign | 0x7C00 | ( magnitude > 0x7F800000 ? 0x200 : 0 ) );
+        if ( magnitude >= 0x477FF000 )
+            return (uint16_t) ( sign | 0x7C00 );
+        if ( magnitude < 0x38800000 )
+        {
+            // Subnormal half.
+            if ( magnitude < 0x33000000 )
+                return (uint16_t) sign;
+            uint32_t mantissa = ( magnitude & 0x7FFFFF ) | 0x800000;
+            int shift = 126 - (int) ( magnitude >> 23 );
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ( ( 1u << shift ) - 1 );
+            uint32_t halfway = 1u << ( shift - 1 );
+            if ( remainder > halfway || ( remainder == halfway && ( half & 1 ) ) )
+                half++;
+            return (uint16_t) ( sign | half );
+        }
+        uint32_t half = ( ( magnitude - 0x38000000 ) >> 13 );
+        uint32_t remainder = magnitude & 0x1FFF;
+        if ( remainder > 0x1000 || ( remainder == 0x1000 && ( half & 1 ) ) )
+            half++;
+        return (uint16_t) ( sign | half );
+    }
+
+
+    static uint32_t PackUnorm( float value, int bits )
+    {
+        float clamped = value < 0.0f ? 0.0f : ( value > 1.0f ? 1.0f : value );
+        return (uint32_t) std::lround( clamped * ( ( 1u << bits ) - 1 ) );
+    }
+
+
+    // Two's complement in the low bits, following the GL 4.2 rule f = max( c / max, -1 ).
+    static uint32_t PackSnorm( float value, int bits )
+    {
+        float clamped = value < -1.0f ? -1.0f : ( value > 1.0f ? 1.0f : value );
+        int32_t scaled = (int32_t) std::lround( clamped * ( ( 1 << ( bits - 1 ) ) - 1 ) );
+        return (uint32_t) scaled & ( ( 1u << bits ) - 1 );
+    }
+
+
+    static void EncodeOctahedral( float x, float y, float z, float& u, float& v )
+    {
+        float sum = std::fabs( x ) + std::fabs( y ) + std::fabs( z );
+        if ( sum == 0.0f )
+        {
+            u = v = 0.0f;
+            return;
+        }
+        u = x / sum;
+        v = y / sum;
+        if ( z < 0.0f )
+        {
+            float foldedU = ( 1.0f - std::fabs( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+            float foldedV = ( 1.0f - std::fabs( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+            u = foldedU;
+            v = foldedV;
+        }
+    }
+
+
+    static void DecodeOctahedral( float u, float v, float& x, float& y, float& z )
+    {
+        x = u;
+        y = v;
+        z = 1.0f - std::fabs( u ) - std::fabs( v );
+        if ( z < 0.0f )
+        {
+            x = ( 1.0f - std::fabs( v ) ) * ( u >= 0.0f ? 1.0f : -1.0f );
+            y = ( 1.0f - std::fabs( u ) ) * ( v >= 0.0f ? 1.0f : -1.0f );
+        }
+        float length = std::sqrt( x * x + y * y + z * z );
+        x /= length;
+        y /= length;
+        z /= length;
+    }
+
+
+private:
+    static void PackAttribute( const VertexAttribute& attribute, const float* source, unsigned char* out )
+    {
+        int count = attribute.components;
+        switch ( attribute.encoding )
+        {
+            case VertexEncoding::FLOAT:
+                memcpy( out, source, count * sizeof( float ) );
+                break;
+            case VertexEncoding::HALF:
+                for ( int i = 0; i < count; i++ )
+                    Store<uint16_t>( out + i * 2, PackHalf( source[i] ) );
+                break;
+            case VertexEncoding::UNORM8:
+                for ( int i = 0; i < count; i++ )
+                    out[i] = (unsigned char) PackUnorm( source[i], 8 );
+                break;
+            case VertexEncoding::SNORM8:
+                for ( int i = 0; i < count; i++ )
+                    out[i] = (unsigned char) PackSnorm( source[i], 8 );
+                break;
+            case VertexEncoding::UNORM16:
+                for ( int i = 0; i < count; i++ )
+                    Store<uint16_t>( out + i * 2, (uint16_t) PackUnorm( source[i], 16 ) );
+                break;
+            case VertexEncoding::SNORM16:
+                for ( int i = 0; i < count; i++ )
+                    Store<uint16_t>( out + i * 2, (uint16_t) PackSnorm( source[i], 16 ) );
+                break;
+            case VertexEncoding::UNORM_10_10_10_2:
+            case VertexEncoding::SNORM_10_10_10_2:
+            {
+                bool isSigned = attribute.encoding == VertexEncoding::SNORM_10_10_10_2;
+                uint32_t word = 0;
+                for ( int i = 0; i < 4; i++ )
+                {
+                    // A missing w reads as 1, like GL does for absent components.
+                    float value = i < count ? source[i] : ( i == 3 ? 1.0f : 0.0f );
+                    int bits = i == 3 ? 2 : 10;
+                    word |= ( isSigned ? PackSnorm( value, bits ) : PackUnorm( value, bits ) ) << ( i * 10 );
+                }
+                Store<uint32_t>( out, word );
+                break;
+            }
+            case VertexEncoding::OCTAHEDRAL:
+            {
+                float u, v;
+                EncodeOctahedral( source[0], source[1], source[2], u, v );
+                Store<uint16_t>( out, (uint16_t) PackSnorm( u, 16 ) );
+                Store<uint16_t>( out + 2, (uint16_t) PackSnorm( v, 16 ) );
+                break;
+            }
+        }
+    }
+
+
+    template <typename T>
+    static void Store( unsigned char* out, T value )
+    {
+        memcpy( out, &value, sizeof( T ) );
+    }
+};
+
+#endif